@@ -0,0 +1,29 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/hash.cpp" "CMakeFiles/janus-bench.dir/src/hash.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/hash.cpp.o.d"
+  "/root/repo/src/http.cpp" "CMakeFiles/janus-bench.dir/src/http.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/http.cpp.o.d"
+  "/root/repo/src/janus.cpp" "CMakeFiles/janus-bench.dir/src/janus.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/janus.cpp.o.d"
+  "/root/repo/src/journal.cpp" "CMakeFiles/janus-bench.dir/src/journal.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/journal.cpp.o.d"
+  "/root/repo/src/metrics.cpp" "CMakeFiles/janus-bench.dir/src/metrics.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/metrics.cpp.o.d"
+  "/root/repo/src/port.cpp" "CMakeFiles/janus-bench.dir/src/port.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/port.cpp.o.d"
+  "/root/repo/src/stream.cpp" "CMakeFiles/janus-bench.dir/src/stream.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/stream.cpp.o.d"
+  "/root/repo/src/unix.cpp" "CMakeFiles/janus-bench.dir/src/unix.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/unix.cpp.o.d"
+  "/root/repo/src/uri.cpp" "CMakeFiles/janus-bench.dir/src/uri.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/uri.cpp.o.d"
+  "/root/repo/src/ws.cpp" "CMakeFiles/janus-bench.dir/src/ws.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/src/ws.cpp.o.d"
+  "/root/repo/tools/janus-bench.cpp" "CMakeFiles/janus-bench.dir/tools/janus-bench.cpp.o" "gcc" "CMakeFiles/janus-bench.dir/tools/janus-bench.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
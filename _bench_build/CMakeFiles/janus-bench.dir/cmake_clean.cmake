@@ -0,0 +1,31 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/janus-bench.dir/src/hash.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/hash.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/http.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/http.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/janus.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/janus.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/journal.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/journal.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/metrics.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/metrics.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/port.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/port.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/stream.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/stream.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/unix.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/unix.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/uri.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/uri.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/src/ws.cpp.o"
+  "CMakeFiles/janus-bench.dir/src/ws.cpp.o.d"
+  "CMakeFiles/janus-bench.dir/tools/janus-bench.cpp.o"
+  "CMakeFiles/janus-bench.dir/tools/janus-bench.cpp.o.d"
+  "janus-bench"
+  "janus-bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/janus-bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
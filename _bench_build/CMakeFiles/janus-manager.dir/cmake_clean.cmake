@@ -0,0 +1,31 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/janus-manager.dir/src/hash.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/hash.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/http.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/http.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/janus.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/janus.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/journal.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/journal.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/main.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/main.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/metrics.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/metrics.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/port.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/port.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/stream.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/stream.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/unix.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/unix.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/uri.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/uri.cpp.o.d"
+  "CMakeFiles/janus-manager.dir/src/ws.cpp.o"
+  "CMakeFiles/janus-manager.dir/src/ws.cpp.o.d"
+  "janus-manager"
+  "janus-manager.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/janus-manager.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
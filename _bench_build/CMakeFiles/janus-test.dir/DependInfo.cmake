@@ -0,0 +1,30 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/hash.cpp" "CMakeFiles/janus-test.dir/src/hash.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/hash.cpp.o.d"
+  "/root/repo/src/http.cpp" "CMakeFiles/janus-test.dir/src/http.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/http.cpp.o.d"
+  "/root/repo/src/janus.cpp" "CMakeFiles/janus-test.dir/src/janus.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/janus.cpp.o.d"
+  "/root/repo/src/journal.cpp" "CMakeFiles/janus-test.dir/src/journal.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/journal.cpp.o.d"
+  "/root/repo/src/metrics.cpp" "CMakeFiles/janus-test.dir/src/metrics.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/metrics.cpp.o.d"
+  "/root/repo/src/port.cpp" "CMakeFiles/janus-test.dir/src/port.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/port.cpp.o.d"
+  "/root/repo/src/stream.cpp" "CMakeFiles/janus-test.dir/src/stream.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/stream.cpp.o.d"
+  "/root/repo/src/unix.cpp" "CMakeFiles/janus-test.dir/src/unix.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/unix.cpp.o.d"
+  "/root/repo/src/uri.cpp" "CMakeFiles/janus-test.dir/src/uri.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/uri.cpp.o.d"
+  "/root/repo/src/ws.cpp" "CMakeFiles/janus-test.dir/src/ws.cpp.o" "gcc" "CMakeFiles/janus-test.dir/src/ws.cpp.o.d"
+  "/root/repo/tests/handlers.cpp" "CMakeFiles/janus-test.dir/tests/handlers.cpp.o" "gcc" "CMakeFiles/janus-test.dir/tests/handlers.cpp.o.d"
+  "/root/repo/tests/port.cpp" "CMakeFiles/janus-test.dir/tests/port.cpp.o" "gcc" "CMakeFiles/janus-test.dir/tests/port.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,33 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/janus-test.dir/src/hash.cpp.o"
+  "CMakeFiles/janus-test.dir/src/hash.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/http.cpp.o"
+  "CMakeFiles/janus-test.dir/src/http.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/janus.cpp.o"
+  "CMakeFiles/janus-test.dir/src/janus.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/journal.cpp.o"
+  "CMakeFiles/janus-test.dir/src/journal.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/metrics.cpp.o"
+  "CMakeFiles/janus-test.dir/src/metrics.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/port.cpp.o"
+  "CMakeFiles/janus-test.dir/src/port.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/stream.cpp.o"
+  "CMakeFiles/janus-test.dir/src/stream.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/unix.cpp.o"
+  "CMakeFiles/janus-test.dir/src/unix.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/uri.cpp.o"
+  "CMakeFiles/janus-test.dir/src/uri.cpp.o.d"
+  "CMakeFiles/janus-test.dir/src/ws.cpp.o"
+  "CMakeFiles/janus-test.dir/src/ws.cpp.o.d"
+  "CMakeFiles/janus-test.dir/tests/handlers.cpp.o"
+  "CMakeFiles/janus-test.dir/tests/handlers.cpp.o.d"
+  "CMakeFiles/janus-test.dir/tests/port.cpp.o"
+  "CMakeFiles/janus-test.dir/tests/port.cpp.o.d"
+  "janus-test"
+  "janus-test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/janus-test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -3,13 +3,23 @@
 #include <boost/log/trivial.hpp>
 #include <chrono>
 #include <functional>
+#include <memory>
 
 static const auto default_timeout = std::chrono::seconds(1);
+static const auto default_timeout_idle = std::chrono::seconds(30);
 static const auto timeout_keepalive = std::chrono::seconds(30);
+static const auto timeout_janus_keepalive = std::chrono::seconds(25);
 static const auto timeout_loop = std::chrono::seconds(1);
-static const auto timeout_retries = std::chrono::milliseconds(100);
+static const auto timeout_probe = std::chrono::milliseconds(10);
+static const auto timeout_probe_max = std::chrono::milliseconds(1000);
+static const auto timeout_startup = std::chrono::seconds(30);
+static const auto timeout_health = std::chrono::seconds(1);
+static const auto timeout_reconcile = std::chrono::seconds(30);
 
-static const std::size_t retries = 256;
+static const std::size_t default_max_sessions = 1024;
+static const std::size_t default_janus_connections = 4;
+static const std::size_t default_janus_window = 16;
+static const std::size_t max_janus_instances = 256;
 
 class guard
 {
@@ -1,35 +1,90 @@
 #include "hash.hpp"
 
-#include <boost/uuid/detail/md5.hpp>
+#include <atomic>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <unistd.h>
 
-std::string gen_uid()
+static std::uint64_t splitmix64(std::uint64_t x)
 {
-    // FIXME:
-    return std::to_string(std::rand());
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
 }
 
-std::string md5()
+struct uid_state
 {
-    return md5(gen_uid());
+    uid_state()
+    {
+        std::random_device rd;
+        std::uint64_t seed = (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+        seed ^= std::chrono::system_clock::now().time_since_epoch().count();
+        seed ^= static_cast<std::uint64_t>(::getpid()) << 48;
+        prefix = splitmix64(seed);
+        key = splitmix64(prefix);
+        offset = splitmix64(key);
+    }
+    std::uint64_t prefix;
+    std::uint64_t key;
+    std::uint32_t offset;
+    std::atomic<std::uint64_t> counter{0};
+    std::atomic<std::uint32_t> stream_counter{0};
+};
+
+// Bijective on 31 bits: odd multipliers and right xorshifts are both
+// invertible modulo 2^31, so distinct inputs never collide.
+static std::uint32_t permute31(std::uint32_t x)
+{
+    static const std::uint32_t mask = 0x7fffffff;
+    x = (x * 0x2c1b3c6du) & mask;
+    x ^= x >> 15;
+    x = (x * 0x297a2d39u) & mask;
+    x ^= x >> 13;
+    return x & mask;
 }
 
-std::string md5(const std::string& buf)
-{
-    static const char map[] = "0123456789abcdef";
-    boost::uuids::detail::md5 hash;
-    boost::uuids::detail::md5::digest_type digest;
-    hash.process_bytes(buf.c_str(), buf.size());
-    hash.get_digest(digest);
-    std::string res;
-    for (std::size_t i = 0; i < 4; ++i) {
-        res.push_back(map[(digest[i] >> 28) & 0x0f]);
-        res.push_back(map[(digest[i] >> 24) & 0x0f]);
-        res.push_back(map[(digest[i] >> 20) & 0x0f]);
-        res.push_back(map[(digest[i] >> 16) & 0x0f]);
-        res.push_back(map[(digest[i] >> 12) & 0x0f]);
-        res.push_back(map[(digest[i] >> 8) & 0x0f]);
-        res.push_back(map[(digest[i] >> 4) & 0x0f]);
-        res.push_back(map[(digest[i]) & 0x0f]);
-    }
+static uid_state& state()
+{
+    static uid_state res;
     return res;
 }
+
+std::string gen_uid()
+{
+    auto& s = state();
+    auto counter = s.counter.fetch_add(1, std::memory_order_relaxed);
+    char buf[32];
+    to_hex(s.prefix, buf);
+    to_hex(splitmix64(counter ^ s.key), buf + 16);
+    return std::string(buf, sizeof(buf));
+}
+
+std::uint32_t gen_stream_id()
+{
+    auto& s = state();
+    return 0x80000000 | permute31(s.offset + s.stream_counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+// Converts eight nibbles at a time: the nibbles are spread one per byte,
+// then each byte is offset to '0'..'9' or 'a'..'f' without branches.
+static std::uint64_t to_hex32(std::uint32_t value)
+{
+    std::uint64_t x = value;
+    x = ((x & 0xffff0000ull) << 16) | (x & 0x0000ffffull);
+    x = ((x & 0x0000ff000000ff00ull) << 8) | (x & 0x000000ff000000ffull);
+    x = ((x & 0x00f000f000f000f0ull) << 4) | (x & 0x000f000f000f000full);
+    std::uint64_t letters = ((x + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull;
+    x += 0x3030303030303030ull + letters * ('a' - '0' - 10);
+    return boost::endian::native_to_big(x);
+}
+
+void to_hex(std::uint64_t value, char* buf)
+{
+    std::uint64_t hi = to_hex32(value >> 32);
+    std::uint64_t lo = to_hex32(value);
+    std::memcpy(buf, &hi, sizeof(hi));
+    std::memcpy(buf + 8, &lo, sizeof(lo));
+}
@@ -1,7 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 std::string gen_uid();
-std::string md5();
-std::string md5(const std::string& buf);
+std::uint32_t gen_stream_id();
+void to_hex(std::uint64_t value, char* buf);
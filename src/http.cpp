@@ -6,135 +6,198 @@ boost::asio::ip::tcp::endpoint make_endpoint(const std::string& host, std::uint1
 http_client::http_client(boost::asio::io_context& ioc,
     boost::asio::ip::tcp::endpoint ep,
     std::chrono::seconds timeout)
-    : ioc_(ioc), socket_(ioc), deadline_(ioc), timeout_(timeout)
+    : socket_(ioc), deadline_(ioc), ep_(ep), timeout_(timeout)
 {
-    start_deadline();
-    connect(ep);
 }
 
-void http_client::connect(boost::asio::ip::tcp::endpoint ep)
+void http_client::operator()(http_req& req, http_res& res, http_client_handler handler)
 {
-    boost::system::error_code ec = boost::asio::error::would_block;
-    deadline_.expires_from_now(timeout_);
-    socket_.async_connect(ep,
-        [&ec](boost::system::error_code e) { ec = e; });
-    do { ioc_.run_one(); } while (ec == boost::asio::error::would_block);
-    if (ec)
-        throw boost::system::system_error(ec);
+    if (!socket_.is_open())
+        connect(req, res, handler);
+    else
+        send(req, res, handler);
 }
 
-void http_client::send(http_req& req)
+void http_client::close()
 {
-    boost::system::error_code ec = boost::asio::error::would_block;
-    deadline_.expires_from_now(timeout_);
+    boost::system::error_code ec;
+    deadline_.cancel();
+    socket_.close(ec);
+    buffer_.consume(buffer_.size());
+}
+
+void http_client::connect(http_req& req, http_res& res, http_client_handler handler)
+{
+    auto self = shared_from_this();
+    start_deadline();
+    socket_.async_connect(ep_,
+        [self, &req, &res, handler](boost::system::error_code e) {
+            self->deadline_.cancel();
+            if (e) {
+                self->close();
+                handler(e);
+                return;
+            }
+            self->send(req, res, handler);
+        });
+}
+
+void http_client::send(http_req& req, http_res& res, http_client_handler handler)
+{
+    auto self = shared_from_this();
+    start_deadline();
     boost::beast::http::async_write(socket_, req,
-        [&ec](boost::system::error_code e, std::size_t) { ec = e; });
-    do { ioc_.run_one(); } while (ec == boost::asio::error::would_block);
-    if (ec)
-        throw boost::system::system_error(ec);
+        [self, &res, handler](boost::system::error_code e, std::size_t) {
+            self->deadline_.cancel();
+            if (e) {
+                self->close();
+                handler(e);
+                return;
+            }
+            self->recv(res, handler);
+        });
 }
 
-void http_client::recv(http_res& res)
+void http_client::recv(http_res& res, http_client_handler handler)
 {
-    boost::system::error_code ec = boost::asio::error::would_block;
-    deadline_.expires_from_now(timeout_);
+    auto self = shared_from_this();
+    start_deadline();
     boost::beast::http::async_read(socket_, buffer_, res,
-        [&ec](boost::system::error_code e, std::size_t) { ec = e; });
-    do { ioc_.run_one(); } while (ec == boost::asio::error::would_block);
-    if (ec)
-        throw boost::system::system_error(ec);
+        [self, &res, handler](boost::system::error_code e, std::size_t) {
+            self->deadline_.cancel();
+            if (e || res.need_eof())
+                self->close();
+            handler(e);
+        });
 }
 
 void http_client::start_deadline()
 {
-    deadline_.expires_at(std::chrono::system_clock::time_point::max());
-    check_deadline();
+    std::weak_ptr<http_client> weak = shared_from_this();
+    deadline_.expires_from_now(timeout_);
+    deadline_.async_wait(
+        [weak](boost::system::error_code e) {
+            auto self = weak.lock();
+            if (e == boost::asio::error::operation_aborted || !self)
+                return;
+            boost::system::error_code ec;
+            self->socket_.close(ec);
+        });
 }
 
-void http_client::check_deadline()
+http_session::http_session(boost::asio::generic::stream_protocol::socket socket, http_handler handler,
+    std::chrono::seconds timeout, std::chrono::seconds timeout_idle,
+    guard closed)
+    : socket_(std::move(socket)), deadline_(socket_.get_executor()),
+      timeout_(timeout), timeout_idle_(timeout_idle), handler_(handler), closed_(std::move(closed))
 {
-    if (deadline_.expires_at() <= std::chrono::system_clock::now()) {
-        try {
-            socket_.cancel();
-        } catch (const std::exception&) {
-        }
-        deadline_.expires_at(std::chrono::system_clock::time_point::max());
-    }
-    deadline_.async_wait(std::bind(&http_client::check_deadline, this));
 }
 
-void http_client::operator()(http_req& req, http_res& res)
+void http_session::operator()()
 {
-    send(req);
-    recv(res);
+    recv();
 }
 
-http_server::http_server(boost::asio::io_context& ioc,
-    boost::asio::ip::tcp::endpoint ep, http_handler handler,
-    std::chrono::seconds timeout)
-  : ioc_(ioc), acceptor_(ioc, ep), socket_(ioc), deadline_(ioc), timeout_(timeout), handler_(handler)
+void http_session::send()
 {
-    start_deadline();
-    accept();
+    auto self = shared_from_this();
+    res_.keep_alive(req_.keep_alive());
+    res_.prepare_payload();
+    start_deadline(timeout_);
+    boost::beast::http::async_write(socket_, res_,
+        [self](boost::system::error_code e, std::size_t) {
+            self->deadline_.cancel();
+            if (e || self->res_.need_eof()) {
+                self->close();
+                return;
+            }
+            self->recv();
+        });
 }
 
-void http_server::cancel()
+void http_session::recv()
 {
-    acceptor_.cancel();
+    auto self = shared_from_this();
+    req_ = {};
+    res_ = {};
+    start_deadline(timeout_idle_);
+    boost::beast::http::async_read(socket_, buffer_, req_,
+        [self](boost::system::error_code e, std::size_t) {
+            self->deadline_.cancel();
+            if (e) {
+                self->close();
+                return;
+            }
+            self->handler_(self->req_, self->res_, [self]() { self->send(); });
+        });
 }
 
-void http_server::accept()
+void http_session::close()
 {
-    socket_ = boost::asio::ip::tcp::socket(ioc_);
-    acceptor_.async_accept(socket_,
-        [this](boost::system::error_code e) { if (!e) operator()(); accept(); });
+    boost::system::error_code ec;
+    socket_.shutdown(boost::asio::socket_base::shutdown_send, ec);
+    socket_.close(ec);
 }
 
-void http_server::send(http_res& res)
+void http_session::start_deadline(std::chrono::seconds timeout)
 {
-    boost::system::error_code ec = boost::asio::error::would_block;
-    deadline_.expires_from_now(timeout_);
-    boost::beast::http::async_write(socket_, res,
-        [&ec](boost::system::error_code e, std::size_t) { ec = e; });
-    do { ioc_.run_one(); } while (ec == boost::asio::error::would_block);
-    if (ec)
-        throw boost::system::system_error(ec);
+    std::weak_ptr<http_session> weak = shared_from_this();
+    deadline_.expires_from_now(timeout);
+    deadline_.async_wait(
+        [weak](boost::system::error_code e) {
+            auto self = weak.lock();
+            if (e == boost::asio::error::operation_aborted || !self)
+                return;
+            self->close();
+        });
 }
 
-void http_server::recv(http_req& req)
+http_server::http_server(boost::asio::io_context& ioc,
+    boost::asio::generic::stream_protocol::endpoint ep, http_handler handler,
+    std::size_t max_sessions,
+    std::chrono::seconds timeout,
+    std::chrono::seconds timeout_idle)
+  : ioc_(ioc), acceptor_(ioc, ep), socket_(ioc),
+    timeout_(timeout), timeout_idle_(timeout_idle), handler_(handler),
+    max_sessions_(max_sessions), self_(std::make_shared<http_server*>(this))
 {
-    boost::system::error_code ec = boost::asio::error::would_block;
-    deadline_.expires_from_now(timeout_);
-    boost::beast::http::async_read(socket_, buffer_, req,
-        [&ec](boost::system::error_code e, std::size_t) { ec = e; });
-    do { ioc_.run_one(); } while (ec == boost::asio::error::would_block);
-    if (ec)
-        throw boost::system::system_error(ec);
+    accept();
 }
 
-void http_server::start_deadline()
+void http_server::cancel()
+{
+    cancelled_ = true;
+    acceptor_.cancel();
+}
+
+std::size_t http_server::sessions() const
 {
-    deadline_.expires_at(std::chrono::system_clock::time_point::max());
-    check_deadline();
+    return sessions_;
 }
 
-void http_server::check_deadline()
+void http_server::accept()
 {
-    if (deadline_.expires_at() <= std::chrono::system_clock::now()) {
-        try {
-            socket_.cancel();
-        } catch (const std::exception&) {
-        }
-        deadline_.expires_at(std::chrono::system_clock::time_point::max());
-    }
-    deadline_.async_wait(std::bind(&http_server::check_deadline, this));
+    if (accepting_ || cancelled_ || sessions_ >= max_sessions_)
+        return;
+    accepting_ = true;
+    socket_ = boost::asio::generic::stream_protocol::socket(ioc_);
+    acceptor_.async_accept(socket_,
+        [this](boost::system::error_code e) {
+            accepting_ = false;
+            if (e == boost::asio::error::operation_aborted)
+                return;
+            if (!e) {
+                std::weak_ptr<http_server*> weak = self_;
+                ++sessions_;
+                std::make_shared<http_session>(std::move(socket_), handler_, timeout_, timeout_idle_,
+                    make_guard([weak]() { if (auto self = weak.lock()) (*self)->release(); }))->operator()();
+            }
+            accept();
+        });
 }
 
-void http_server::operator()()
+void http_server::release()
 {
-    http_req req;
-    http_res res;
-    recv(req);
-    handler_(req, res);
-    send(res);
+    --sessions_;
+    accept();
 }
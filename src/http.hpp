@@ -6,8 +6,12 @@
 #include <boost/asio/system_timer.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <memory>
 
 boost::asio::ip::tcp::endpoint make_endpoint(
     const std::string& host, std::uint16_t port);
@@ -20,9 +24,11 @@ using http_res =
     boost::beast::http::response<
         boost::beast::http::string_body>;
 
-using http_handler = std::function<void(http_req&, http_res&)>;
+using http_callback = std::function<void()>;
+using http_handler = std::function<void(http_req&, http_res&, http_callback)>;
+using http_client_handler = std::function<void(boost::system::error_code)>;
 
-class http_client
+class http_client : public std::enable_shared_from_this<http_client>
 {
 public:
     http_client(boost::asio::io_context& ioc,
@@ -32,43 +38,73 @@ public:
     http_client& operator=(const http_client&) = delete;
     http_client(http_client&&) = delete;
     http_client& operator=(http_client&&) = delete;
-    void operator()(http_req& req, http_res& res);
+    void operator()(http_req& req, http_res& res, http_client_handler handler);
+    void close();
 private:
-    void connect(boost::asio::ip::tcp::endpoint ep);
-    void send(http_req& req);
-    void recv(http_res& res);
+    void connect(http_req& req, http_res& res, http_client_handler handler);
+    void send(http_req& req, http_res& res, http_client_handler handler);
+    void recv(http_res& res, http_client_handler handler);
     void start_deadline();
-    void check_deadline();
-    boost::asio::io_context& ioc_;
     boost::asio::ip::tcp::socket socket_;
     boost::asio::system_timer deadline_;
     boost::beast::flat_buffer buffer_;
+    boost::asio::ip::tcp::endpoint ep_;
     std::chrono::seconds timeout_;
 };
 
+class http_session : public std::enable_shared_from_this<http_session>
+{
+public:
+    http_session(boost::asio::generic::stream_protocol::socket socket, http_handler handler,
+        std::chrono::seconds timeout, std::chrono::seconds timeout_idle,
+        guard closed);
+    http_session(const http_session&) = delete;
+    http_session& operator=(const http_session&) = delete;
+    http_session(http_session&&) = delete;
+    http_session& operator=(http_session&&) = delete;
+    void operator()();
+private:
+    void send();
+    void recv();
+    void close();
+    void start_deadline(std::chrono::seconds timeout);
+    boost::asio::generic::stream_protocol::socket socket_;
+    boost::asio::system_timer deadline_;
+    boost::beast::flat_buffer buffer_;
+    std::chrono::seconds timeout_;
+    std::chrono::seconds timeout_idle_;
+    http_handler handler_;
+    http_req req_;
+    http_res res_;
+    guard closed_;
+};
+
 class http_server
 {
 public:
     http_server(boost::asio::io_context& ioc,
-        boost::asio::ip::tcp::endpoint ep, http_handler handler,
-        std::chrono::seconds timeout = default_timeout);
+        boost::asio::generic::stream_protocol::endpoint ep, http_handler handler,
+        std::size_t max_sessions = default_max_sessions,
+        std::chrono::seconds timeout = default_timeout,
+        std::chrono::seconds timeout_idle = default_timeout_idle);
     http_server(const http_server&) = delete;
     http_server& operator=(const http_server&) = delete;
     http_server(http_server&&) = delete;
     http_server& operator=(http_server&&) = delete;
     void cancel();
-    void operator()();
+    std::size_t sessions() const;
 private:
     void accept();
-    void send(http_res& res);
-    void recv(http_req& req);
-    void start_deadline();
-    void check_deadline();
+    void release();
     boost::asio::io_context& ioc_;
-    boost::asio::ip::tcp::acceptor acceptor_;
-    boost::asio::ip::tcp::socket socket_;
-    boost::asio::system_timer deadline_;
-    boost::beast::flat_buffer buffer_;
+    boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol> acceptor_;
+    boost::asio::generic::stream_protocol::socket socket_;
     std::chrono::seconds timeout_;
+    std::chrono::seconds timeout_idle_;
     http_handler handler_;
+    std::size_t sessions_ = 0;
+    std::size_t max_sessions_;
+    bool accepting_ = false;
+    bool cancelled_ = false;
+    std::shared_ptr<http_server*> self_;
 };
@@ -0,0 +1,656 @@
+#include "janus.hpp"
+#include "hash.hpp"
+#include "metrics.hpp"
+
+#include <unordered_map>
+
+static const int janus_error_session_not_found = 458;
+static const int janus_error_handle_not_found = 459;
+
+static std::string make_target()
+{ return "/janus"; }
+static std::string make_target(std::uint64_t session_id)
+{ return make_target() + "/" + std::to_string(session_id); }
+static std::string make_target(std::uint64_t session_id, std::uint64_t session_plugin_id)
+{ return make_target() + "/" + std::to_string(session_id) + "/" + std::to_string(session_plugin_id); }
+
+static const char* janus_call_types[] = {
+    "create", "attach", "keepalive", "stream_create", "stream_destroy", "stream_list", "other"};
+
+struct janus_metrics
+{
+    janus_metrics()
+    {
+        for (std::size_t i = 0; i < rtt.size(); ++i) {
+            auto labels = std::string("type=\"") + janus_call_types[i] + "\"";
+            metrics().add("janus_manager_janus_rtt_seconds", "Janus call round-trip time.", labels, rtt[i]);
+            metrics().add("janus_manager_janus_errors_total", "Failed Janus calls.", labels, errors[i]);
+        }
+    }
+    std::array<metric_histogram, 7> rtt;
+    std::array<metric_counter, 7> errors;
+};
+
+static janus_metrics& get_janus_metrics()
+{
+    static janus_metrics m;
+    return m;
+}
+
+static std::size_t janus_call_type(const nlohmann::json& req_json)
+{
+    auto janus = req_json.value("janus", "");
+    if (janus == "message") {
+        auto request = req_json.count("body") ? req_json["body"].value("request", "") : "";
+        return request == "create" ? 3 : request == "destroy" ? 4 : request == "list" ? 5 : 6;
+    }
+    return janus == "create" ? 0 : janus == "attach" ? 1 : janus == "keepalive" ? 2 : 6;
+}
+
+static bool is_success(const nlohmann::json& res_json)
+{ return res_json.value("janus", "") == "success"; }
+
+static bool is_session_lost(const nlohmann::json& res_json)
+{
+    if (res_json.value("janus", "") != "error")
+        return false;
+    try {
+        int code = res_json.at("error").at("code");
+        return code == janus_error_session_not_found || code == janus_error_handle_not_found;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+class janus_http_transport : public janus_transport,
+    public std::enable_shared_from_this<janus_http_transport>
+{
+public:
+    janus_http_transport(boost::asio::io_context& ioc,
+        boost::asio::ip::tcp::endpoint ep,
+        std::size_t connections,
+        std::chrono::seconds timeout)
+    {
+        for (std::size_t i = 0; i < std::max<std::size_t>(connections, 1); ++i)
+            clients_.push_back(std::make_shared<http_client>(ioc, ep, timeout));
+        idle_ = clients_;
+    }
+
+    void operator()(std::uint64_t session_id, std::uint64_t session_plugin_id,
+        nlohmann::json req_json, janus_json_handler handler) override
+    {
+        auto client = idle_.back();
+        idle_.pop_back();
+        auto target = session_plugin_id ? make_target(session_id, session_plugin_id) :
+            session_id ? make_target(session_id) : make_target();
+        auto req = std::make_shared<http_req>(boost::beast::http::verb::post, target, 11);
+        auto res = std::make_shared<http_res>();
+        req->set(boost::beast::http::field::content_type, "application/json");
+        req->keep_alive(true);
+        req->body() = req_json.dump();
+        req->prepare_payload();
+        auto self = shared_from_this();
+        (*client)(*req, *res,
+            [self, client, req, res, req_json, handler](boost::system::error_code ec) {
+                self->idle_.push_back(client);
+                if (ec) {
+                    BOOST_LOG_TRIVIAL(error) << "client error: " << ec.message();
+                    handler(false, nlohmann::json());
+                    return;
+                }
+                if (res->result() != boost::beast::http::status::ok) {
+                    BOOST_LOG_TRIVIAL(error) << "client error: " << res->result_int();
+                    handler(false, nlohmann::json());
+                    return;
+                }
+                nlohmann::json res_json;
+                try {
+                    res_json = nlohmann::json::parse(res->body());
+                } catch (const std::exception& e) {
+                    BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+                    handler(false, nlohmann::json());
+                    return;
+                }
+                if (res_json.value("transaction", "") != req_json["transaction"]) {
+                    BOOST_LOG_TRIVIAL(error) << "client error: transaction mismatch";
+                    handler(false, nlohmann::json());
+                    return;
+                }
+                handler(true, res_json);
+            });
+    }
+
+    std::size_t capacity() const override
+    { return clients_.size(); }
+
+    void close() override
+    {
+        for (auto& client : clients_)
+            client->close();
+    }
+private:
+    std::vector<std::shared_ptr<http_client>> clients_;
+    std::vector<std::shared_ptr<http_client>> idle_;
+};
+
+template <typename client>
+class janus_message_transport : public janus_transport,
+    public std::enable_shared_from_this<janus_message_transport<client>>
+{
+public:
+    janus_message_transport(boost::asio::io_context& ioc,
+        std::shared_ptr<client> c,
+        std::size_t window,
+        std::chrono::seconds timeout)
+        : ioc_(ioc), client_(std::move(c)), window_(std::max<std::size_t>(window, 1)), timeout_(timeout)
+    {
+    }
+
+    void start()
+    {
+        std::weak_ptr<janus_message_transport> weak = this->shared_from_this();
+        client_->on_recv(
+            [weak](const std::string& msg) {
+                if (auto self = weak.lock())
+                    self->recv(msg);
+            });
+        client_->on_close(
+            [weak](boost::system::error_code ec) {
+                if (auto self = weak.lock())
+                    self->lost(ec);
+            });
+    }
+
+    void operator()(std::uint64_t session_id, std::uint64_t session_plugin_id,
+        nlohmann::json req_json, janus_json_handler handler) override
+    {
+        if (session_id)
+            req_json["session_id"] = session_id;
+        if (session_plugin_id)
+            req_json["handle_id"] = session_plugin_id;
+        std::string transaction = req_json["transaction"];
+        std::weak_ptr<janus_message_transport> weak = this->shared_from_this();
+        auto& p = pending_[transaction];
+        p.handler = handler;
+        p.message = req_json.value("janus", "") == "message";
+        p.deadline = std::make_shared<boost::asio::system_timer>(ioc_);
+        p.deadline->expires_from_now(timeout_);
+        p.deadline->async_wait(
+            [weak, transaction](boost::system::error_code e) {
+                auto self = weak.lock();
+                if (e == boost::asio::error::operation_aborted || !self)
+                    return;
+                BOOST_LOG_TRIVIAL(error) << "client error: transaction " << transaction << " timed out";
+                self->done(transaction, false, nlohmann::json());
+            });
+        (*client_)(req_json.dump(),
+            [weak, transaction](boost::system::error_code e) {
+                auto self = weak.lock();
+                if (!e || !self)
+                    return;
+                BOOST_LOG_TRIVIAL(error) << "client error: " << e.message();
+                self->done(transaction, false, nlohmann::json());
+            });
+    }
+
+    std::size_t capacity() const override
+    { return window_; }
+
+    void close() override
+    { client_->close(); }
+private:
+    struct pending
+    {
+        janus_json_handler handler;
+        std::shared_ptr<boost::asio::system_timer> deadline;
+        bool message = false;
+    };
+
+    void recv(const std::string& msg)
+    {
+        nlohmann::json res_json;
+        try {
+            res_json = nlohmann::json::parse(msg);
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+            return;
+        }
+        auto janus = res_json.value("janus", "");
+        auto transaction = res_json.value("transaction", "");
+        if (transaction.empty()) {
+            if (janus == "timeout") {
+                BOOST_LOG_TRIVIAL(debug) << "janus session timed out";
+                if (on_close_)
+                    on_close_();
+            }
+            return;
+        }
+        auto it = pending_.find(transaction);
+        if (it == pending_.end())
+            return;
+        if (it->second.message && janus == "ack")
+            return;
+        done(transaction, true, res_json);
+    }
+
+    void done(const std::string& transaction, bool ok, const nlohmann::json& res_json)
+    {
+        auto it = pending_.find(transaction);
+        if (it == pending_.end())
+            return;
+        auto p = std::move(it->second);
+        pending_.erase(it);
+        p.deadline->cancel();
+        p.handler(ok, res_json);
+    }
+
+    void lost(boost::system::error_code ec)
+    {
+        if (ec != boost::asio::error::operation_aborted)
+            BOOST_LOG_TRIVIAL(error) << "client error: " << ec.message();
+        std::unordered_map<std::string, pending> pending;
+        pending.swap(pending_);
+        if (on_close_)
+            on_close_();
+        for (auto& p : pending) {
+            p.second.deadline->cancel();
+            p.second.handler(false, nlohmann::json());
+        }
+    }
+
+    boost::asio::io_context& ioc_;
+    std::shared_ptr<client> client_;
+    std::unordered_map<std::string, pending> pending_;
+    std::size_t window_;
+    std::chrono::seconds timeout_;
+};
+
+std::shared_ptr<janus_transport> make_janus_http_transport(boost::asio::io_context& ioc,
+    boost::asio::ip::tcp::endpoint ep,
+    std::size_t connections,
+    std::chrono::seconds timeout)
+{
+    return std::make_shared<janus_http_transport>(ioc, ep, connections, timeout);
+}
+
+std::shared_ptr<janus_transport> make_janus_ws_transport(boost::asio::io_context& ioc,
+    boost::asio::ip::tcp::endpoint ep,
+    std::size_t window,
+    std::chrono::seconds timeout)
+{
+    auto transport = std::make_shared<janus_message_transport<ws_client>>(ioc,
+        std::make_shared<ws_client>(ioc, ep, "/", "janus-protocol", timeout), window, timeout);
+    transport->start();
+    return transport;
+}
+
+std::shared_ptr<janus_transport> make_janus_unix_transport(boost::asio::io_context& ioc,
+    const std::string& path,
+    std::size_t window,
+    std::chrono::seconds timeout)
+{
+    auto transport = std::make_shared<janus_message_transport<unix_client>>(ioc,
+        std::make_shared<unix_client>(ioc, path, timeout), window, timeout);
+    transport->start();
+    return transport;
+}
+
+janus_client::janus_client(boost::asio::io_context& ioc, std::shared_ptr<janus_transport> transport,
+    std::string admin_key)
+    : transport_(std::move(transport)), admin_key_(std::move(admin_key)), keep_alive_(ioc)
+{
+    get_janus_metrics();
+}
+
+void janus_client::start()
+{
+    std::weak_ptr<janus_client> weak = shared_from_this();
+    transport_->on_close(
+        [weak]() {
+            auto self = weak.lock();
+            if (!self || !self->session_id_)
+                return;
+            BOOST_LOG_TRIVIAL(debug) << "janus session lost";
+            self->session_id_ = 0;
+            self->session_plugin_id_ = 0;
+        });
+    cancelled_ = false;
+    start_keep_alive();
+}
+
+void janus_client::cancel()
+{
+    cancelled_ = true;
+    keep_alive_.cancel();
+    transport_->close();
+    fail();
+}
+
+void janus_client::reset()
+{
+    session_id_ = 0;
+    session_plugin_id_ = 0;
+    transport_->close();
+}
+
+// Queued like any other call, so it waits for a free connection, but sent
+// outside of a session: Janus answers it before the plugin can be attached.
+void janus_client::ping(janus_handler handler)
+{
+    call c;
+    c.req_json["janus"] = "ping";
+    c.message = false;
+    c.session = false;
+    c.retries = 0;
+    c.handler = [handler](bool ok, const nlohmann::json& res_json) {
+        handler(ok && res_json.value("janus", "") == "pong");
+    };
+    calls_.push_back(std::move(c));
+    next();
+}
+
+void janus_client::stream_create(const stream_info& stream, janus_handler handler)
+{
+    nlohmann::json body;
+    body["request"] = "create";
+    body["id"] = stream.id;
+    body["description"] = std::to_string(stream.port);
+    body["type"] = "rtp";
+    body["video"] = true;
+    body["videoport"] = stream.port;
+    body["videopt"] = 96;
+    body["videortpmap"] = "H264/90000";
+    body["videofmtp"] = "profile-level-id=42e01f;packetization-mode=1";
+    body["audio"] = true;
+    body["audioport"] = stream.port + 2;
+    body["audiopt"] = 8;
+    body["audiortpmap"] = "PCMA/8000/1";
+    body["is_private"] = true;
+    if (!admin_key_.empty())
+        body["admin_key"] = admin_key_;
+    operator()(body,
+        [handler](bool ok, const nlohmann::json& res_json) {
+            try {
+                ok = ok && is_success(res_json) &&
+                    res_json.at("plugindata").at("data").count("created");
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+                ok = false;
+            }
+            handler(ok);
+        });
+}
+
+void janus_client::stream_remove(const stream_info& stream, janus_handler handler)
+{
+    nlohmann::json body;
+    body["request"] = "destroy";
+    body["id"] = stream.id;
+    operator()(body,
+        [handler](bool ok, const nlohmann::json& res_json) {
+            handler(ok && is_success(res_json));
+        });
+}
+
+// The port is not in the list reply, so it is read back from the description
+// set on create; mountpoints with string ids are not ours and are skipped.
+// Ours are private, and Janus lists private mountpoints only to a request
+// carrying the plugin's admin_key.
+void janus_client::stream_list(janus_list_handler handler)
+{
+    nlohmann::json body;
+    body["request"] = "list";
+    if (!admin_key_.empty())
+        body["admin_key"] = admin_key_;
+    operator()(body,
+        [handler](bool ok, const nlohmann::json& res_json) {
+            std::vector<stream_info> streams;
+            try {
+                ok = ok && is_success(res_json);
+                if (ok) {
+                    for (const auto& item : res_json.at("plugindata").at("data").at("list")) {
+                        if (!item.at("id").is_number_unsigned())
+                            continue;
+                        stream_info stream;
+                        stream.id = item.at("id");
+                        stream.port = static_cast<std::uint16_t>(
+                            std::strtoul(item.value("description", "").c_str(), nullptr, 10));
+                        streams.push_back(stream);
+                    }
+                }
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+                ok = false;
+            }
+            handler(ok, streams);
+        });
+}
+
+void janus_client::stream_create(std::vector<stream_info> streams, janus_bulk_handler handler,
+    std::size_t window)
+{
+    bulk(static_cast<stream_handler>(&janus_client::stream_create), std::move(streams), handler, window);
+}
+
+void janus_client::stream_remove(std::vector<stream_info> streams, janus_bulk_handler handler,
+    std::size_t window)
+{
+    bulk(static_cast<stream_handler>(&janus_client::stream_remove), std::move(streams), handler, window);
+}
+
+void janus_client::operator()(const nlohmann::json& body, janus_json_handler handler)
+{
+    call c;
+    c.req_json["janus"] = "message";
+    c.req_json["body"] = body;
+    c.handler = handler;
+    calls_.push_back(std::move(c));
+    ++stats_.messages;
+    next();
+}
+
+const janus_stats& janus_client::stats() const
+{
+    return stats_;
+}
+
+void janus_client::bulk(stream_handler op, std::vector<stream_info> streams, janus_bulk_handler handler,
+    std::size_t window)
+{
+    struct state
+    {
+        std::vector<stream_info> streams;
+        std::vector<std::pair<stream_info, bool>> results;
+        std::size_t pos = 0;
+        std::size_t pending = 0;
+        std::function<void()> next;
+    };
+    auto st = std::make_shared<state>();
+    st->streams = std::move(streams);
+    st->results.reserve(st->streams.size());
+    if (st->streams.empty()) {
+        handler(st->results);
+        return;
+    }
+    auto self = shared_from_this();
+    st->next = [self, st, op, handler, window]() {
+        while (st->pos < st->streams.size() && st->pending < std::max<std::size_t>(window, 1)) {
+            auto& stream = st->streams[st->pos++];
+            ++st->pending;
+            (self.get()->*op)(stream,
+                [st, handler, stream](bool ok) {
+                    --st->pending;
+                    st->results.emplace_back(stream, ok);
+                    if (st->results.size() == st->streams.size()) {
+                        auto next = std::move(st->next);
+                        handler(st->results);
+                        return;
+                    }
+                    st->next();
+                });
+        }
+    };
+    st->next();
+}
+
+void janus_client::next()
+{
+    while (!cancelled_ && !attaching_ && !calls_.empty() && pending_ < transport_->capacity()) {
+        if (calls_.front().session && !session_plugin_id_) {
+            attach();
+            return;
+        }
+        auto c = std::make_shared<call>(std::move(calls_.front()));
+        calls_.pop_front();
+        auto session_id = c->session ? session_id_ : 0;
+        auto self = shared_from_this();
+        ++pending_;
+        send(session_id, c->message ? session_plugin_id_ : 0, c->req_json,
+            [self, c, session_id](bool ok, const nlohmann::json& res_json) {
+                --self->pending_;
+                bool lost = ok && is_session_lost(res_json);
+                if (lost && self->session_id_ == session_id) {
+                    BOOST_LOG_TRIVIAL(debug) << "janus session lost";
+                    self->session_id_ = 0;
+                    self->session_plugin_id_ = 0;
+                }
+                if ((!ok || lost) && c->retries) {
+                    --c->retries;
+                    self->calls_.push_front(std::move(*c));
+                    self->next();
+                    return;
+                }
+                if (!ok || lost)
+                    ++self->stats_.failures;
+                c->handler(ok && !lost, res_json);
+                self->next();
+            });
+    }
+}
+
+void janus_client::attach(std::size_t retries)
+{
+    attaching_ = true;
+    ++pending_;
+    auto self = shared_from_this();
+    auto done = [self]() {
+        self->attaching_ = false;
+        --self->pending_;
+    };
+    nlohmann::json req_json;
+    req_json["janus"] = "create";
+    send(0, 0, req_json,
+        [self, done, retries](bool ok, const nlohmann::json& res_json) {
+            if (!ok && retries) {
+                done();
+                self->attach(retries - 1);
+                return;
+            }
+            std::uint64_t session_id = 0;
+            try {
+                if (ok && is_success(res_json))
+                    session_id = res_json.at("data").at("id");
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+            }
+            if (!session_id) {
+                done();
+                self->fail();
+                return;
+            }
+            nlohmann::json req_json;
+            req_json["janus"] = "attach";
+            req_json["plugin"] = "janus.plugin.streaming";
+            self->send(session_id, 0, req_json,
+                [self, done, session_id](bool ok, const nlohmann::json& res_json) {
+                    std::uint64_t session_plugin_id = 0;
+                    try {
+                        if (ok && is_success(res_json))
+                            session_plugin_id = res_json.at("data").at("id");
+                    } catch (const std::exception& e) {
+                        BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+                    }
+                    done();
+                    if (!session_plugin_id) {
+                        self->fail();
+                        return;
+                    }
+                    BOOST_LOG_TRIVIAL(debug) << "janus session " << session_id
+                        << " plugin " << session_plugin_id;
+                    self->session_id_ = session_id;
+                    self->session_plugin_id_ = session_plugin_id;
+                    ++self->stats_.sessions;
+                    self->next();
+                });
+        });
+}
+
+void janus_client::keep_alive()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::system_clock::now() - stats_.started_at).count();
+    auto rtt = std::chrono::microseconds(stats_.calls ? stats_.latency.count() / stats_.calls : 0);
+    auto saved = 2 * stats_.messages - std::min(2 * stats_.messages, 2 * stats_.sessions);
+    BOOST_LOG_TRIVIAL(debug) << "janus:"
+        << " calls=" << stats_.calls
+        << " rate=" << (elapsed > 0 ? stats_.calls / elapsed : 0) << "/s"
+        << " rtt=" << rtt.count() << "us"
+        << " saved calls=" << saved
+        << " saved time=" << saved * rtt.count() << "us";
+    if (!session_id_ || !calls_.empty())
+        return;
+    call c;
+    c.req_json["janus"] = "keepalive";
+    c.message = false;
+    c.retries = 0;
+    c.handler = [](bool, const nlohmann::json&) {};
+    calls_.push_back(std::move(c));
+    next();
+}
+
+void janus_client::start_keep_alive()
+{
+    std::weak_ptr<janus_client> weak = shared_from_this();
+    keep_alive_.expires_from_now(timeout_janus_keepalive);
+    keep_alive_.async_wait(
+        [weak](boost::system::error_code ec) {
+            auto self = weak.lock();
+            if (ec == boost::asio::error::operation_aborted || !self)
+                return;
+            self->keep_alive();
+            self->start_keep_alive();
+        });
+}
+
+void janus_client::fail()
+{
+    std::deque<call> calls;
+    calls.swap(calls_);
+    for (auto& c : calls) {
+        ++stats_.failures;
+        c.handler(false, nlohmann::json());
+    }
+}
+
+void janus_client::send(std::uint64_t session_id, std::uint64_t session_plugin_id,
+    nlohmann::json req_json, janus_json_handler handler)
+{
+    req_json["transaction"] = gen_uid();
+    BOOST_LOG_TRIVIAL(trace) << "client send: " << req_json;
+    auto self = shared_from_this();
+    auto type = janus_call_type(req_json);
+    auto started_at = std::chrono::system_clock::now();
+    ++stats_.calls;
+    (*transport_)(session_id, session_plugin_id, req_json,
+        [self, handler, type, started_at](bool ok, const nlohmann::json& res_json) {
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now() - started_at);
+            self->stats_.latency += latency;
+            get_janus_metrics().rtt[type].observe(latency);
+            if (!ok)
+                get_janus_metrics().errors[type].inc();
+            if (ok)
+                BOOST_LOG_TRIVIAL(trace) << "client recv: " << res_json;
+            handler(ok, res_json);
+        });
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "http.hpp"
+#include "stream.hpp"
+#include "unix.hpp"
+#include "ws.hpp"
+
+#include <deque>
+#include <nlohmann/json.hpp>
+
+using janus_handler = std::function<void(bool)>;
+using janus_json_handler = std::function<void(bool, const nlohmann::json&)>;
+using janus_bulk_handler = std::function<void(const std::vector<std::pair<stream_info, bool>>&)>;
+using janus_list_handler = std::function<void(bool, const std::vector<stream_info>&)>;
+
+struct janus_stats
+{
+    std::uint64_t calls = 0;
+    std::uint64_t messages = 0;
+    std::uint64_t sessions = 0;
+    std::uint64_t failures = 0;
+    std::chrono::microseconds latency = std::chrono::microseconds(0);
+    std::chrono::system_clock::time_point started_at = std::chrono::system_clock::now();
+};
+
+class janus_transport
+{
+public:
+    virtual ~janus_transport() = default;
+    virtual void operator()(std::uint64_t session_id, std::uint64_t session_plugin_id,
+        nlohmann::json req_json, janus_json_handler handler) = 0;
+    virtual std::size_t capacity() const = 0;
+    virtual void close() = 0;
+    void on_close(std::function<void()> handler) { on_close_ = handler; }
+protected:
+    std::function<void()> on_close_;
+};
+
+std::shared_ptr<janus_transport> make_janus_http_transport(boost::asio::io_context& ioc,
+    boost::asio::ip::tcp::endpoint ep,
+    std::size_t connections = default_janus_connections,
+    std::chrono::seconds timeout = default_timeout);
+
+std::shared_ptr<janus_transport> make_janus_ws_transport(boost::asio::io_context& ioc,
+    boost::asio::ip::tcp::endpoint ep,
+    std::size_t window = default_janus_window,
+    std::chrono::seconds timeout = default_timeout);
+
+std::shared_ptr<janus_transport> make_janus_unix_transport(boost::asio::io_context& ioc,
+    const std::string& path,
+    std::size_t window = default_janus_window,
+    std::chrono::seconds timeout = default_timeout);
+
+class janus_client : public std::enable_shared_from_this<janus_client>
+{
+public:
+    janus_client(boost::asio::io_context& ioc, std::shared_ptr<janus_transport> transport,
+        std::string admin_key = std::string());
+    janus_client(const janus_client&) = delete;
+    janus_client& operator=(const janus_client&) = delete;
+    janus_client(janus_client&&) = delete;
+    janus_client& operator=(janus_client&&) = delete;
+    void start();
+    void cancel();
+    void reset();
+    void ping(janus_handler handler);
+    void stream_create(const stream_info& stream, janus_handler handler);
+    void stream_remove(const stream_info& stream, janus_handler handler);
+    void stream_list(janus_list_handler handler);
+    void stream_create(std::vector<stream_info> streams, janus_bulk_handler handler,
+        std::size_t window = default_janus_window);
+    void stream_remove(std::vector<stream_info> streams, janus_bulk_handler handler,
+        std::size_t window = default_janus_window);
+    void operator()(const nlohmann::json& body, janus_json_handler handler);
+    const janus_stats& stats() const;
+private:
+    struct call
+    {
+        nlohmann::json req_json;
+        janus_json_handler handler;
+        bool message = true;
+        bool session = true;
+        std::size_t retries = 1;
+    };
+    using stream_handler = void (janus_client::*)(const stream_info&, janus_handler);
+    void bulk(stream_handler op, std::vector<stream_info> streams, janus_bulk_handler handler,
+        std::size_t window);
+    void next();
+    void attach(std::size_t retries = 1);
+    void keep_alive();
+    void start_keep_alive();
+    void fail();
+    void send(std::uint64_t session_id, std::uint64_t session_plugin_id,
+        nlohmann::json req_json, janus_json_handler handler);
+    std::shared_ptr<janus_transport> transport_;
+    std::string admin_key_;
+    boost::asio::system_timer keep_alive_;
+    std::deque<call> calls_;
+    std::uint64_t session_id_ = 0;
+    std::uint64_t session_plugin_id_ = 0;
+    std::size_t pending_ = 0;
+    bool attaching_ = false;
+    bool cancelled_ = false;
+    janus_stats stats_;
+};
@@ -0,0 +1,298 @@
+#include "journal.hpp"
+
+#include <boost/asio/post.hpp>
+#include <boost/crc.hpp>
+#include <boost/endian/buffers.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+
+// Both files are a header followed by records. A record is the fixed part below
+// and the host bytes; the crc covers everything after itself, so a torn tail
+// left by a crash is detected and cut off on load. The instance byte was
+// reserved and zero before streams were sharded, so older files load onto
+// instance 0.
+
+static const std::uint32_t journal_magic = 0x524d4a4a;
+static const std::uint32_t journal_version = 1;
+static const std::size_t journal_compact_records = 4096;
+
+enum journal_type : std::uint8_t
+{
+    journal_put = 1,
+    journal_keep_alive = 2,
+    journal_keep_alive_all = 3,
+    journal_erase = 4,
+};
+
+struct journal_header
+{
+    boost::endian::little_uint32_buf_t magic;
+    boost::endian::little_uint32_buf_t version;
+};
+
+struct journal_record
+{
+    boost::endian::little_uint32_buf_t crc;
+    boost::endian::little_uint8_buf_t type;
+    boost::endian::little_uint8_buf_t instance;
+    boost::endian::little_uint16_buf_t port;
+    boost::endian::little_uint32_buf_t host_size;
+    boost::endian::little_uint64_buf_t id;
+    boost::endian::little_int64_buf_t expires_at;
+};
+
+static_assert(sizeof(journal_header) == 8, "unexpected journal header size");
+static_assert(sizeof(journal_record) == 28, "unexpected journal record size");
+
+static std::uint32_t crc(const char* data, std::size_t size)
+{
+    boost::crc_32_type res;
+    res.process_bytes(data, size);
+    return res.checksum();
+}
+
+static std::int64_t to_us(std::chrono::system_clock::time_point t)
+{ return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count(); }
+
+static std::chrono::system_clock::time_point from_us(std::int64_t us)
+{
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(us)));
+}
+
+static void append_header(std::string& res)
+{
+    journal_header header;
+    header.magic = journal_magic;
+    header.version = journal_version;
+    res.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+static void append_record(std::string& res, std::uint8_t type, std::uint64_t id, std::uint16_t port,
+    std::uint32_t instance, std::chrono::system_clock::time_point expires_at, const std::string& host)
+{
+    journal_record record;
+    record.type = type;
+    record.instance = static_cast<std::uint8_t>(instance);
+    record.port = port;
+    record.host_size = static_cast<std::uint32_t>(host.size());
+    record.id = id;
+    record.expires_at = to_us(expires_at);
+    auto offset = res.size();
+    res.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    res.append(host);
+    auto data = &res[offset] + sizeof(record.crc);
+    record.crc = crc(data, res.size() - offset - sizeof(record.crc));
+    std::memcpy(&res[offset], &record.crc, sizeof(record.crc));
+}
+
+static void write_all(int fd, const std::string& data, const std::string& path)
+{
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        auto n = ::write(fd, data.data() + pos, data.size() - pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw std::system_error(errno, std::generic_category(), "write " + path);
+        pos += n;
+    }
+}
+
+stream_journal::stream_journal(boost::asio::io_context& ioc, std::string dir, const stream_registry& streams)
+    : ioc_(ioc), dir_(std::move(dir)), streams_(streams)
+{
+    boost::filesystem::create_directories(dir_);
+}
+
+stream_journal::~stream_journal()
+{
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "journal error: " << e.what();
+    }
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+std::size_t stream_journal::load(stream_registry& streams)
+{
+    snapshot_records_ = replay(dir_ + "/streams.snapshot", streams, false);
+    records_ = replay(dir_ + "/streams.journal", streams, true);
+    open();
+    return snapshot_records_ + records_;
+}
+
+void stream_journal::put(const stream_info& stream)
+{
+    append(journal_put, stream.id, stream.port, stream.instance, stream.expires_at, stream.host);
+}
+
+void stream_journal::keep_alive(const stream_info& stream)
+{
+    append(journal_keep_alive, stream.id, 0, 0, stream.expires_at, std::string());
+}
+
+void stream_journal::keep_alive(std::chrono::system_clock::time_point expires_at)
+{
+    append(journal_keep_alive_all, 0, 0, 0, expires_at, std::string());
+}
+
+void stream_journal::erase(std::uint64_t id)
+{
+    append(journal_erase, id, 0, 0, std::chrono::system_clock::time_point(), std::string());
+}
+
+void stream_journal::flush()
+{
+    if (buffer_.empty() || fd_ < 0)
+        return;
+    std::string buffer;
+    buffer.swap(buffer_);
+    write_all(fd_, buffer, dir_ + "/streams.journal");
+    if (records_ > 2 * std::max(snapshot_records_, journal_compact_records))
+        compact();
+}
+
+void stream_journal::compact()
+{
+    auto path = dir_ + "/streams.snapshot";
+    auto tmp = path + ".tmp";
+    std::string data;
+    data.reserve(sizeof(journal_header) + streams_.size() * (sizeof(journal_record) + 16));
+    append_header(data);
+    for (const auto& stream : streams_)
+        append_record(data, journal_put, stream.id, stream.port, stream.instance, stream.expires_at, stream.host);
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + tmp);
+    try {
+        write_all(fd, data, tmp);
+        if (::fsync(fd) < 0)
+            throw std::system_error(errno, std::generic_category(), "fsync " + tmp);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (::rename(tmp.c_str(), path.c_str()) < 0)
+        throw std::system_error(errno, std::generic_category(), "rename " + tmp);
+    int dir = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    buffer_.clear();
+    if (fd_ >= 0 && ::ftruncate(fd_, sizeof(journal_header)) < 0)
+        throw std::system_error(errno, std::generic_category(), "truncate " + dir_ + "/streams.journal");
+    BOOST_LOG_TRIVIAL(debug) << "journal: compacted records=" << records_ << " streams=" << streams_.size();
+    records_ = 0;
+    snapshot_records_ = streams_.size();
+}
+
+std::size_t stream_journal::records() const
+{
+    return records_;
+}
+
+void stream_journal::append(std::uint8_t type, std::uint64_t id, std::uint16_t port,
+    std::uint32_t instance, std::chrono::system_clock::time_point expires_at, const std::string& host)
+{
+    append_record(buffer_, type, id, port, instance, expires_at, host);
+    ++records_;
+    if (flushing_)
+        return;
+    flushing_ = true;
+    boost::asio::post(ioc_,
+        [this]() {
+            flushing_ = false;
+            try {
+                flush();
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "journal error: " << e.what();
+            }
+        });
+}
+
+std::size_t stream_journal::replay(const std::string& path, stream_registry& streams, bool truncate)
+{
+    boost::system::error_code ec;
+    auto size = boost::filesystem::file_size(path, ec);
+    if (ec || size < sizeof(journal_header))
+        return 0;
+    boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(file, boost::interprocess::read_only, 0, size);
+    auto data = static_cast<const char*>(region.get_address());
+    journal_header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic.value() != journal_magic || header.version.value() != journal_version) {
+        BOOST_LOG_TRIVIAL(warning) << "journal: ignore " << path << ", unknown format";
+        if (truncate)
+            boost::filesystem::remove(path, ec);
+        return 0;
+    }
+    std::size_t pos = sizeof(header);
+    std::size_t count = 0;
+    while (pos + sizeof(journal_record) <= size) {
+        journal_record record;
+        std::memcpy(&record, data + pos, sizeof(record));
+        auto record_size = sizeof(record) + record.host_size.value();
+        if (pos + record_size > size ||
+            crc(data + pos + sizeof(record.crc), record_size - sizeof(record.crc)) != record.crc.value())
+            break;
+        auto expires_at = from_us(record.expires_at.value());
+        switch (record.type.value()) {
+        case journal_put: {
+            stream_info stream;
+            stream.id = record.id.value();
+            stream.host.assign(data + pos + sizeof(record), record.host_size.value());
+            stream.port = record.port.value();
+            stream.instance = record.instance.value();
+            stream.expires_at = expires_at;
+            streams.insert(stream);
+            break;
+        }
+        case journal_keep_alive:
+            if (auto stream = streams.find(record.id.value()))
+                streams.keep_alive(*stream, expires_at);
+            break;
+        case journal_keep_alive_all:
+            for (auto& stream : streams)
+                streams.keep_alive(stream, expires_at);
+            break;
+        case journal_erase:
+            streams.erase(record.id.value());
+            break;
+        default:
+            break;
+        }
+        pos += record_size;
+        ++count;
+    }
+    if (pos != size) {
+        BOOST_LOG_TRIVIAL(warning) << "journal: " << path << " is damaged at offset " << pos
+            << ", " << size - pos << " bytes dropped";
+        if (truncate && ::truncate(path.c_str(), pos) < 0)
+            throw std::system_error(errno, std::generic_category(), "truncate " + path);
+    }
+    return count;
+}
+
+void stream_journal::open()
+{
+    auto path = dir_ + "/streams.journal";
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    if (::lseek(fd_, 0, SEEK_END) == 0) {
+        std::string header;
+        append_header(header);
+        write_all(fd_, header, path);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "stream.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+class stream_journal
+{
+public:
+    stream_journal(boost::asio::io_context& ioc, std::string dir, const stream_registry& streams);
+    stream_journal(const stream_journal&) = delete;
+    stream_journal& operator=(const stream_journal&) = delete;
+    stream_journal(stream_journal&&) = delete;
+    stream_journal& operator=(stream_journal&&) = delete;
+   ~stream_journal();
+    std::size_t load(stream_registry& streams);
+    void put(const stream_info& stream);
+    void keep_alive(const stream_info& stream);
+    void keep_alive(std::chrono::system_clock::time_point expires_at);
+    void erase(std::uint64_t id);
+    void flush();
+    void compact();
+    std::size_t records() const;
+private:
+    void append(std::uint8_t type, std::uint64_t id, std::uint16_t port, std::uint32_t instance,
+        std::chrono::system_clock::time_point expires_at, const std::string& host);
+    std::size_t replay(const std::string& path, stream_registry& streams, bool truncate);
+    void open();
+    boost::asio::io_context& ioc_;
+    std::string dir_;
+    const stream_registry& streams_;
+    std::string buffer_;
+    std::size_t records_ = 0;
+    std::size_t snapshot_records_ = 0;
+    int fd_ = -1;
+    bool flushing_ = false;
+};
@@ -1,54 +1,193 @@
 #include "hash.hpp"
 #include "http.hpp"
+#include "janus.hpp"
+#include "journal.hpp"
+#include "metrics.hpp"
 #include "stream.hpp"
 #include "uri.hpp"
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio/signal_set.hpp>
 #include <boost/log/core.hpp>
+#include <boost/core/null_deleter.hpp>
 #include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/block_on_overflow.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/drop_on_overflow.hpp>
 #include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
-#include <boost/log/utility/setup/console.hpp>
-#include <boost/log/utility/setup/file.hpp>
+#include <boost/log/utility/setup/formatter_parser.hpp>
 #include <boost/process.hpp>
 
+#include <cstring>
 #include <nlohmann/json.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
 
 static boost::log::trivial::severity_level severity = boost::log::trivial::info;
+static std::string log_overflow = "drop";
 static std::string client_conf = "/etc/janus";
 static std::string client_host = "127.0.0.1";
 static std::uint16_t client_port = 8088;
 static std::uint16_t client_admin_port = 8089;
+static std::string client_admin_secret = "janusoverlord";
+static std::string client_streaming_key;
+static std::size_t client_health_failures = 3;
+static std::chrono::milliseconds client_health_slo(500);
+static std::size_t client_warm_min = 0;
+static std::size_t client_warm_max = 0;
+static std::uint16_t client_ws_port = 8188;
+static std::string client_transport = "http";
+static std::string client_path = "/var/run/janus.sock";
+static std::size_t client_connections = default_janus_connections;
+static std::size_t client_window = default_janus_window;
+static std::size_t client_instances = 1;
+static std::uint16_t client_port_step = 10;
 static std::uint16_t client_rtp_port_min = 20000;
 static std::uint16_t client_rtp_port_max = 20999;
-static std::uint16_t client_rtp_port = client_rtp_port_min;
 static std::string server_host = "127.0.0.1";
 static std::uint16_t server_port = 8087;
-static stream_info_map streams;
+static std::string server_path;
+static std::size_t server_max_sessions = default_max_sessions;
+static std::string registry_dir;
+static stream_registry streams;
 
 static boost::asio::io_context ioc;
 static boost::asio::system_timer deadline(ioc);
-static boost::process::child process;
+static boost::asio::signal_set children(ioc, SIGCHLD);
+static boost::asio::system_timer expiry(ioc);
+
+enum janus_state { janus_stopped, janus_starting, janus_ready };
+
+struct janus_instance
+{
+    std::uint32_t index = 0;
+    std::string conf;
+    std::uint16_t port = 0;
+    std::uint16_t admin_port = 0;
+    std::uint16_t ws_port = 0;
+    std::string path;
+    boost::process::child process;
+    std::shared_ptr<janus_client> janus;
+    std::shared_ptr<http_client> admin;
+    std::unique_ptr<port_pool> ports;
+    std::vector<stream_info> warm;
+    bool refilling = false;
+    janus_state state = janus_stopped;
+    std::uint64_t generation = 0;
+    boost::asio::system_timer probe{ioc};
+    boost::asio::system_timer health{ioc};
+    boost::asio::system_timer reconciler{ioc};
+    bool reconciling = false;
+    std::size_t health_failures = 0;
+    bool health_pending = false;
+    std::chrono::system_clock::time_point spawned_at;
+    std::chrono::system_clock::time_point detected_at;
+    metric_counter respawns;
+    metric_counter unhealthy;
+    metric_histogram admin_latency;
+};
+
+static std::vector<std::unique_ptr<janus_instance>> instances;
+static std::unique_ptr<stream_journal> journal;
+static std::unordered_set<std::uint64_t> creating;
+static std::unordered_map<std::string, std::vector<std::function<void(bool, const stream_info&)>>> inflight;
+static const auto started_at = std::chrono::system_clock::now();
+static std::chrono::microseconds startup_duration(0);
+static std::chrono::microseconds restore_duration(0);
+static metric_counter api_responses[5];
+static metric_counter api_coalesced;
+static metric_counter log_dropped;
+static metric_counter log_blocked;
+static std::function<void()> stop_logging;
+static metric_histogram respawn_duration;
+static metric_histogram recovery_duration;
+static metric_histogram expiry_duration;
+static metric_counter expiry_reaped;
+static metric_counter reconcile_created;
+static metric_counter reconcile_destroyed;
+
+static void start_expiry();
+
+static void update_expiry()
+{
+    if (streams.next_expiry() < expiry.expiry())
+        start_expiry();
+}
+
+static const std::size_t stream_json_size = 96;
+static const std::size_t max_batch_size = 10000;
+static const std::size_t max_reconcile_size = 1000;
+
+static janus_instance& instance_of(const stream_info& stream)
+{ return *instances[stream.instance]; }
+
+static janus_instance* least_loaded()
+{
+    janus_instance* res = nullptr;
+    for (auto& instance : instances)
+        if (instance->state == janus_ready && (!res || instance->ports->occupancy() < res->ports->occupancy()))
+            res = instance.get();
+    return res;
+}
+
+static void refill(janus_instance& instance);
+
+// mounted is set when Janus already has the mountpoint, either because the
+// host is known or because a pre-created one was taken from the warm pool.
+static stream_info place_stream(const std::string& host, bool& mounted)
+{
+    if (auto stream = streams.find_host(host)) {
+        mounted = true;
+        return *stream;
+    }
+    auto instance = least_loaded();
+    if (!instance)
+        throw std::runtime_error("janus unavailable");
+    if (!instance->warm.empty()) {
+        auto stream = instance->warm.back();
+        instance->warm.pop_back();
+        stream.host = host;
+        mounted = true;
+        refill(*instance);
+        return stream;
+    }
+    auto stream = make_stream(streams, *instance->ports, host, mounted);
+    stream.instance = instance->index;
+    return stream;
+}
 
 static std::string application(const char* argv0)
 { return boost::filesystem::path(argv0).filename().string(); }
 
-static std::string make_target()
-{ return "/janus"; }
-static std::string make_target(std::uint64_t session_id)
-{ return make_target() + "/" + std::to_string(session_id); }
-static std::string make_target(std::uint64_t session_id, std::uint64_t session_plugin_id)
-{ return make_target() + "/" + std::to_string(session_id) + "/" + std::to_string(session_plugin_id); }
+static std::chrono::system_clock::time_point make_expires_at(const std::string& value)
+{
+    if (value == "min")
+        return std::chrono::system_clock::time_point::min();
+    if (value == "max")
+        return std::chrono::system_clock::time_point::max();
+    return std::chrono::system_clock::time_point(std::chrono::seconds(std::stoi(value)));
+}
 
 static std::chrono::system_clock::time_point query_expires_at(const uri_query& query)
 {
+    if (!query.count("expires_at"))
+        return std::chrono::system_clock::now() + timeout_keepalive;
+    return make_expires_at(query.at("expires_at"));
+}
+
+static std::chrono::system_clock::time_point json_expires_at(const nlohmann::json& item)
+{
+    auto it = item.find("expires_at");
+    if (it == item.end())
+        return std::chrono::system_clock::now() + timeout_keepalive;
+    if (it->is_number())
+        return std::chrono::system_clock::time_point(std::chrono::seconds(it->get<std::int64_t>()));
     try {
-        std::string value = query.at("expires_at");
-        if (value == "min")
-            return std::chrono::system_clock::time_point::min();
-        if (value == "max")
-            return std::chrono::system_clock::time_point::max();
-        return std::chrono::system_clock::time_point(std::chrono::seconds(std::stoi(value)));
+        return make_expires_at(it->get<std::string>());
     } catch (const std::out_of_range&) {
         return std::chrono::system_clock::now() + timeout_keepalive;
     }
@@ -60,129 +199,109 @@ static std::string query_host(const uri_query& query)
     return value;
 }
 
-static bool send(
-    http_client& c, const std::string& target, nlohmann::json& req_json, nlohmann::json& res_json)
+static void append_uint(std::string& res, std::uint64_t value)
 {
-    http_req req(boost::beast::http::verb::post, target, 11);
-    http_res res;
-    req.set(boost::beast::http::field::content_type, "application/json");
-    req.keep_alive(true);
-    req.body() = req_json.dump();
-    req.prepare_payload();
-    c(req, res);
-    if (res.result() == boost::beast::http::status::ok) {
-        try {
-            res_json = nlohmann::json::parse(res.body());
-        } catch (const std::exception& e) {
-            BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
-            return false;
-        }
-        BOOST_LOG_TRIVIAL(trace) << "client send: " << req_json;
-        BOOST_LOG_TRIVIAL(trace) << "client recv: " << res_json;
-        return true;
-    }
-    return false;
+    char buf[20];
+    char* end = buf + sizeof(buf);
+    char* pos = end;
+    do {
+        *--pos = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    res.append(pos, end);
 }
 
-static bool send_session_create(
-    http_client& c, std::uint64_t& session_id)
+static void append_int(std::string& res, std::int64_t value)
 {
-    std::string target = make_target();
-    nlohmann::json req_json;
-    nlohmann::json res_json;
-    req_json["janus"] = "create";
-    req_json["transaction"] = md5();
-    if (!send(c, target, req_json, res_json))
-        return false;
-    try {
-        if (res_json["janus"] != "success" ||
-            res_json["transaction"] != req_json["transaction"])
-            return false;
-        session_id = res_json["data"]["id"];
-    } catch (const std::exception& e) {
-        BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
-        return false;
+    if (value < 0) {
+        res.push_back('-');
+        append_uint(res, 0 - static_cast<std::uint64_t>(value));
+        return;
     }
-    return true;
+    append_uint(res, value);
 }
 
-static bool send_session_plugin_attach(
-    http_client& c, std::uint64_t session_id, std::uint64_t& session_plugin_id)
+static void stream_to_json(const stream_info& stream, std::string& res)
 {
-    session_plugin_id = 0;
-    std::string target = make_target(session_id);
-    nlohmann::json req_json;
-    nlohmann::json res_json;
-    req_json["janus"] = "attach";
-    req_json["transaction"] = md5();
-    req_json["plugin"] = "janus.plugin.streaming";
-    if (!send(c, target, req_json, res_json))
-        return false;
-    try {
-        if (res_json["janus"] != "success" ||
-            res_json["transaction"] != req_json["transaction"])
-            return false;
-        session_plugin_id = res_json["data"]["id"];
-    } catch (const std::exception& e) {
-        BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
-        return false;
-    }
-    return true;
+    res += "{\"audio_port\":";
+    append_uint(res, stream.port + 2);
+    res += ",\"expires_at\":";
+    append_int(res, std::chrono::duration_cast<std::chrono::milliseconds>(
+        stream.expires_at.time_since_epoch()).count());
+    res += ",\"id\":";
+    append_uint(res, stream.id);
+    res += ",\"video_port\":";
+    append_uint(res, stream.port);
+    res += '}';
 }
 
-static bool send_session_stream_create(
-    http_client& c, std::uint64_t session_id, std::uint64_t session_plugin_id,
-    const stream_info& stream)
+static void append_string(std::string& res, const std::string& value)
 {
-    std::string target = make_target(session_id, session_plugin_id);
-    nlohmann::json req_json;
-    nlohmann::json res_json;
-    req_json["janus"] = "message";
-    req_json["transaction"] = md5();
-    req_json["body"]["request"] = "create";
-    req_json["body"]["id"] = stream.id;
-    req_json["body"]["type"] = "rtp";
-    req_json["body"]["video"] = true;
-    req_json["body"]["videoport"] = stream.port;
-    req_json["body"]["videopt"] = 96;
-    req_json["body"]["videortpmap"] = "H264/90000";
-    req_json["body"]["videofmtp"] = "profile-level-id=42e01f;packetization-mode=1";
-    req_json["body"]["audio"] = true;
-    req_json["body"]["audioport"] = stream.port + 2;
-    req_json["body"]["audiopt"] = 8;
-    req_json["body"]["audiortpmap"] = "PCMA/8000/1";
-    req_json["body"]["is_private"] = true;
-    if (!send(c, target, req_json, res_json))
-        return false;
-    try {
-        if (res_json["janus"] != "success" ||
-            res_json["transaction"] != req_json["transaction"] ||
-            res_json["plugindata"]["data"].count("created") == 0)
-            return false;
-    } catch (const std::exception& e) {
-        BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
-        return false;
+    res += nlohmann::json(value).dump();
+}
+
+struct stream_batch_item
+{
+    std::string host;
+    std::uint64_t id = 0;
+    std::chrono::system_clock::time_point expires_at;
+    stream_info stream;
+    std::string error;
+};
+
+static void stream_batch_to_body(const std::vector<stream_batch_item>& items, http_res& res)
+{
+    auto& body = res.body();
+    body.reserve(items.size() * (stream_json_size + 48) + 32);
+    body += "{\"streams\":[";
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        auto& item = items[i];
+        if (i)
+            body += ',';
+        body += '{';
+        if (!item.host.empty()) {
+            body += "\"host\":";
+            append_string(body, item.host);
+        } else {
+            body += "\"id\":";
+            append_uint(body, item.id);
+        }
+        if (!item.error.empty()) {
+            body += ",\"error\":";
+            append_string(body, item.error);
+        } else {
+            body += ",\"stream\":";
+            stream_to_json(item.stream, body);
+        }
+        body += '}';
     }
-    return true;
+    body += "]}";
+    res.prepare_payload();
 }
 
-static bool send_session_stream_remove(
-    http_client& c, std::uint64_t session_id, std::uint64_t session_plugin_id,
-    const stream_info& stream)
+static bool make_stream_batch(const std::string& s, std::vector<stream_batch_item>& items)
 {
-    std::string target = make_target(session_id, session_plugin_id);
-    nlohmann::json req_json;
-    nlohmann::json res_json;
-    req_json["janus"] = "message";
-    req_json["transaction"] = md5();
-    req_json["body"]["request"] = "destroy";
-    req_json["body"]["id"] = stream.id;
-    if (!send(c, target, req_json, res_json))
-        return false;
     try {
-        if (res_json["janus"] != "success" ||
-            res_json["transaction"] != req_json["transaction"])
+        auto req_json = nlohmann::json::parse(s);
+        auto& streams_json = req_json.at("streams");
+        if (!streams_json.is_array() || streams_json.size() > max_batch_size)
             return false;
+        items.resize(streams_json.size());
+        for (std::size_t i = 0; i < streams_json.size(); ++i) {
+            auto& item_json = streams_json[i];
+            auto& item = items[i];
+            try {
+                if (item_json.count("host"))
+                    item.host = item_json.at("host").get<std::string>();
+                else
+                    item.id = item_json.at("id").get<std::uint64_t>();
+                if (item.host.empty() && !item.id)
+                    throw std::invalid_argument("invalid item");
+                item.expires_at = json_expires_at(item_json);
+            } catch (const std::exception&) {
+                item.error = "invalid item";
+            }
+        }
     } catch (const std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
         return false;
@@ -190,16 +309,14 @@ static bool send_session_stream_remove(
     return true;
 }
 
-static nlohmann::json stream_to_json(const stream_info& stream)
+static void stream_to_body(const stream_info& stream, http_res& res)
 {
-    nlohmann::json res_json;
-    res_json["id"] = stream.id;
-    res_json["video_port"] = stream.port;
-    res_json["audio_port"] = stream.port + 2;
-    res_json["expires_at"] =
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            stream.expires_at.time_since_epoch()).count();
-    return res_json;
+    auto& body = res.body();
+    body.reserve(stream_json_size + 16);
+    body += "{\"stream\":";
+    stream_to_json(stream, body);
+    body += '}';
+    res.prepare_payload();
 }
 
 static void handle_ok(http_req& req, http_res& res)
@@ -214,204 +331,838 @@ static void handle_not_found(http_req& req, http_res& res)
 { res = http_res(boost::beast::http::status::not_found, req.version()); }
 static void handle_method_not_allowed(http_req& req, http_res& res)
 { res = http_res(boost::beast::http::status::method_not_allowed, req.version()); }
+static void handle_service_unavailable(http_req& req, http_res& res)
+{ res = http_res(boost::beast::http::status::service_unavailable, req.version()); }
 
-static void handle_streams_post(http_req& req, http_res& res, const uri_query& query)
-{
-    bool already_existed = false;
-    auto stream = make_stream(streams, query_host(query),
-        client_rtp_port_min, client_rtp_port_max, client_rtp_port, already_existed);
-    if (!already_existed) {
-        boost::asio::io_context ioc;
-        http_client c(ioc, make_endpoint(client_host, client_port));
-        std::uint64_t session_id;
-        std::uint64_t session_plugin_id;
-        if (!send_session_create(c, session_id) ||
-            !send_session_plugin_attach(c, session_id, session_plugin_id) ||
-            !send_session_stream_create(c, session_id, session_plugin_id, stream)) {
-            BOOST_LOG_TRIVIAL(error) << "client error";
-            handle_internal_server_error(req, res);
-            return;
-        }
+// Requests for a host whose mountpoint is being created wait for that creation
+// instead of starting their own; settle() hands its outcome to all of them.
+static bool join(const std::string& host, std::function<void(bool, const stream_info&)> handler)
+{
+    auto it = inflight.find(host);
+    if (it == inflight.end())
+        return false;
+    BOOST_LOG_TRIVIAL(debug) << "coalesce host " << host;
+    it->second.push_back(std::move(handler));
+    api_coalesced.inc();
+    return true;
+}
+
+static void settle(const stream_info& stream, bool ok)
+{
+    auto it = inflight.find(stream.host);
+    if (it == inflight.end())
+        return;
+    auto handlers = std::move(it->second);
+    inflight.erase(it);
+    for (auto& handler : handlers)
+        handler(ok, stream);
+}
+
+static stream_info* find_stream(http_req& req, http_res& res, http_callback callback,
+    boost::string_view param)
+{
+    std::uint64_t id = 0;
+    auto stream = uri_to_uint(param, id) ? streams.find(id) : nullptr;
+    if (!stream) {
+        handle_not_found(req, res);
+        callback();
     }
-    keep_alive(stream, query_expires_at(query));
-    streams[stream.id] = std::move(stream);
-    handle_ok(req, res);
-    nlohmann::json res_json;
-    res_json["stream"] = stream_to_json(stream);
-    res.body() = res_json.dump();
-    res.prepare_payload();
+    return stream;
 }
 
-static void handle_streams_get(http_req& req, http_res& res, const uri_query& query)
+static void report(const std::string& name,
+    const std::vector<std::pair<stream_info, bool>>& results,
+    std::chrono::system_clock::time_point started_at)
 {
-    handle_ok(req, res);
-    nlohmann::json res_json;
-    for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        res_json["streams"].push_back(stream_to_json(stream));
+    if (results.empty())
+        return;
+    std::size_t failed = 0;
+    for (auto& result : results) {
+        if (result.second)
+            continue;
+        BOOST_LOG_TRIVIAL(debug) << name << " stream " << result.first.id << ": client error";
+        ++failed;
     }
-    res.body() = res_json.dump();
-    res.prepare_payload();
+    BOOST_LOG_SEV(boost::log::trivial::logger::get(),
+        failed ? boost::log::trivial::error : boost::log::trivial::debug) << name << ":"
+        << " streams=" << results.size()
+        << " failed=" << failed
+        << " time=" << std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now() - started_at).count() << "ms";
 }
 
-static void handle_streams_put(http_req& req, http_res& res, const uri_query& query)
+static void shard(std::vector<stream_info> streams,
+    void (janus_client::*op)(std::vector<stream_info>, janus_bulk_handler, std::size_t),
+    janus_bulk_handler handler)
 {
-    handle_ok(req, res);
-    nlohmann::json res_json;
-    for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        keep_alive(stream, query_expires_at(query));
-        res_json["streams"].push_back(stream_to_json(stream));
+    std::vector<std::vector<stream_info>> shards(instances.size());
+    for (auto& stream : streams)
+        shards[stream.instance].push_back(std::move(stream));
+    auto results = std::make_shared<std::vector<std::pair<stream_info, bool>>>();
+    auto done = make_shared_guard([handler, results]() { handler(*results); });
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        if (shards[i].empty())
+            continue;
+        ((*instances[i]->janus).*op)(std::move(shards[i]),
+            [results, done](const std::vector<std::pair<stream_info, bool>>& shard_results) {
+                results->insert(results->end(), shard_results.begin(), shard_results.end());
+            }, client_window);
     }
-    res.body() = res_json.dump();
-    res.prepare_payload();
 }
 
-static void handle_streams_id_get(http_req& req, http_res& res, const uri_query& query,
-    stream_info& stream)
+static void create(std::vector<stream_info> streams, janus_bulk_handler handler)
+{
+    shard(std::move(streams), &janus_client::stream_create, handler);
+}
+
+static void remove(std::vector<stream_info> expires)
+{
+    expires.erase(std::remove_if(expires.begin(), expires.end(),
+        [](const stream_info& stream) { return instance_of(stream).state != janus_ready; }), expires.end());
+    if (expires.empty())
+        return;
+    BOOST_LOG_TRIVIAL(debug) << "registry:"
+        << " streams=" << streams.size()
+        << " memory=" << streams.memory() << "b";
+    auto started_at = std::chrono::system_clock::now();
+    shard(std::move(expires), &janus_client::stream_remove,
+        [started_at](const std::vector<std::pair<stream_info, bool>>& results) {
+            report("remove", results, started_at);
+        });
+}
+
+static void commit(stream_info& stream, std::chrono::system_clock::time_point expires_at)
+{
+    keep_alive(stream, expires_at);
+    streams.insert(stream);
+    if (journal)
+        journal->put(stream);
+}
+
+static void handle_streams_post(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
 {
+    auto host = query_host(query);
+    auto expires_at = query_expires_at(query);
+    auto done = [&req, &res, callback, expires_at](stream_info stream) {
+        commit(stream, expires_at);
+        update_expiry();
+        handle_ok(req, res);
+        stream_to_body(stream, res);
+        callback();
+    };
+    auto joined = !streams.find_host(host) && join(host,
+        [&req, &res, callback, done](bool ok, const stream_info& stream) {
+            if (!ok) {
+                handle_internal_server_error(req, res);
+                callback();
+                return;
+            }
+            done(stream);
+        });
+    if (joined)
+        return;
+    if (!streams.find_host(host) && !least_loaded()) {
+        handle_service_unavailable(req, res);
+        callback();
+        return;
+    }
+    bool mounted = false;
+    auto stream = place_stream(host, mounted);
+    if (mounted) {
+        done(stream);
+        return;
+    }
+    inflight[host];
+    creating.insert(stream.id);
+    instance_of(stream).janus->stream_create(stream,
+        [&req, &res, callback, done, stream](bool ok) {
+            creating.erase(stream.id);
+            if (!ok) {
+                BOOST_LOG_TRIVIAL(error) << "client error";
+                instance_of(stream).ports->release(stream.port);
+                handle_internal_server_error(req, res);
+                callback();
+                settle(stream, false);
+                return;
+            }
+            done(stream);
+            settle(stream, true);
+        });
+}
+
+static void handle_streams_get(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
+{
+    std::uint64_t limit = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t cursor = 0;
+    if ((query.count("limit") && (!uri_to_uint(query.raw("limit"), limit) || !limit)) ||
+        (query.count("cursor") && !uri_to_uint(query.raw("cursor"), cursor))) {
+        handle_bad_request(req, res);
+        callback();
+        return;
+    }
     handle_ok(req, res);
-    nlohmann::json res_json;
-    res_json["stream"] = stream_to_json(stream);
-    res.body() = res_json.dump();
+    auto& body = res.body();
+    body.reserve(std::min<std::uint64_t>(limit, streams.size()) * (stream_json_size + 1) + 32);
+    body += "{\"streams\":[";
+    std::uint64_t count = 0;
+    std::uint64_t slot = cursor;
+    for ( ; slot < streams.slots() && count < limit; ++slot) {
+        auto stream = streams.slot(slot);
+        if (!stream)
+            continue;
+        if (count++)
+            body += ',';
+        stream_to_json(*stream, body);
+    }
+    body += ']';
+    if (slot < streams.slots()) {
+        body += ",\"cursor\":";
+        append_uint(body, slot);
+    }
+    body += '}';
     res.prepare_payload();
+    callback();
 }
 
-static void handle_streams_id_put(http_req& req, http_res& res, const uri_query& query,
-    stream_info& stream)
+static void handle_streams_put(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
 {
-    keep_alive(stream, query_expires_at(query));
+    auto expires_at = query_expires_at(query);
     handle_ok(req, res);
-    nlohmann::json res_json;
-    res_json["stream"] = stream_to_json(stream);
-    res.body() = res_json.dump();
+    auto& body = res.body();
+    body.reserve(streams.size() * (stream_json_size + 1) + 32);
+    body += "{\"streams\":[";
+    std::size_t count = 0;
+    for (auto& stream : streams) {
+        streams.keep_alive(stream, expires_at);
+        if (count++)
+            body += ',';
+        stream_to_json(stream, body);
+    }
+    body += "]}";
+    if (journal)
+        journal->keep_alive(expires_at);
+    update_expiry();
     res.prepare_payload();
+    callback();
 }
 
-static void handle(http_req& req, http_res& res)
+static void handle_streams_batch_post(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
 {
-    auto uri = make_uri(std::string(req.target()));
-    auto path = make_path(uri.path);
-    auto query = make_query(uri.query);
-    if (std::distance(path.begin(), path.end()) == 2 &&
-        path.is_absolute() && std::next(path.begin(), 1)->string() == "streams") {
-        switch (req.method()) {
-        case boost::beast::http::verb::post: handle_streams_post(req, res, query); break;
-        case boost::beast::http::verb::get: handle_streams_get(req, res, query); break;
-        case boost::beast::http::verb::put: handle_streams_put(req, res, query); break;
-        default: handle_method_not_allowed(req, res); break;
-        }
+    auto items = std::make_shared<std::vector<stream_batch_item>>();
+    if (!make_stream_batch(req.body(), *items)) {
+        handle_bad_request(req, res);
+        callback();
         return;
     }
-    if (std::distance(path.begin(), path.end()) == 3 &&
-        path.is_absolute() && std::next(path.begin(), 1)->string() == "streams") {
-        auto it = streams.find(std::stoul(std::next(path.begin(), 2)->string()));
-        if (it == streams.end()) {
-            handle_not_found(req, res);
+    // Streams the registry already has are kept alive here, warm ones are
+    // registered as soon as they are bound and joined ones when they settle;
+    // only new mountpoints wait for the creates. Nothing is written back at the
+    // end, so a stream the expiry reaps meanwhile stays reaped.
+    auto pending = std::make_shared<std::size_t>(1);
+    auto finish = [&req, &res, callback, items, pending]() {
+        if (--*pending)
             return;
+        update_expiry();
+        handle_ok(req, res);
+        stream_batch_to_body(*items, res);
+        callback();
+    };
+    std::unordered_map<std::string, std::size_t> hosts;
+    std::vector<stream_info> created;
+    for (std::size_t i = 0; i < items->size(); ++i) {
+        auto& item = (*items)[i];
+        if (!item.error.empty())
+            continue;
+        if (item.host.empty()) {
+            item.error = "invalid item";
+            continue;
         }
-        auto& stream = it->second;
-        switch (req.method()) {
-        case boost::beast::http::verb::get: handle_streams_id_get(req, res, query, stream); break;
-        case boost::beast::http::verb::put: handle_streams_id_put(req, res, query, stream); break;
-        default: handle_method_not_allowed(req, res); break;
+        auto joined = !streams.find_host(item.host) && join(item.host,
+            [items, i, finish](bool ok, const stream_info& stream) {
+                auto& item = (*items)[i];
+                if (ok) {
+                    item.stream = stream;
+                    commit(item.stream, item.expires_at);
+                } else {
+                    item.error = "client error";
+                }
+                finish();
+            });
+        if (joined) {
+            ++*pending;
+            continue;
         }
+        if (auto stream = streams.find_host(item.host)) {
+            streams.keep_alive(*stream, item.expires_at);
+            if (journal)
+                journal->keep_alive(*stream);
+            item.stream = *stream;
+            continue;
+        }
+        auto it = hosts.find(item.host);
+        if (it != hosts.end()) {
+            item.stream = (*items)[it->second].stream;
+            continue;
+        }
+        try {
+            bool mounted = false;
+            item.stream = place_stream(item.host, mounted);
+            if (!mounted) {
+                created.push_back(item.stream);
+                inflight[item.host];
+            } else {
+                commit(item.stream, item.expires_at);
+            }
+            hosts[item.host] = i;
+        } catch (const std::exception& e) {
+            item.error = e.what();
+        }
+    }
+    for (auto& stream : created)
+        creating.insert(stream.id);
+    create(std::move(created),
+        [items, finish](const std::vector<std::pair<stream_info, bool>>& results) {
+            std::unordered_map<std::uint64_t, bool> created;
+            for (auto& result : results) {
+                creating.erase(result.first.id);
+                created[result.first.id] = result.second;
+                if (!result.second) {
+                    BOOST_LOG_TRIVIAL(error) << "client error";
+                    instance_of(result.first).ports->release(result.first.port);
+                }
+            }
+            for (auto& item : *items) {
+                if (!item.error.empty())
+                    continue;
+                auto it = created.find(item.stream.id);
+                if (it != created.end() && !it->second)
+                    item.error = "client error";
+                else if (it != created.end())
+                    commit(item.stream, item.expires_at);
+            }
+            for (auto& result : results)
+                settle(result.first, result.second);
+            finish();
+        });
+}
+
+static void handle_streams_batch_put(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
+{
+    std::vector<stream_batch_item> items;
+    if (!make_stream_batch(req.body(), items)) {
+        handle_bad_request(req, res);
+        callback();
         return;
     }
-    handle_not_found(req, res);
+    for (auto& item : items) {
+        if (!item.error.empty())
+            continue;
+        auto stream = item.host.empty() ? streams.find(item.id) : streams.find_host(item.host);
+        if (!stream) {
+            item.error = "not found";
+            continue;
+        }
+        streams.keep_alive(*stream, item.expires_at);
+        if (journal)
+            journal->keep_alive(*stream);
+        item.stream = *stream;
+    }
+    update_expiry();
+    handle_ok(req, res);
+    stream_batch_to_body(items, res);
+    callback();
+}
+
+static void handle_streams_id_get(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
+{
+    auto stream = find_stream(req, res, callback, param);
+    if (!stream)
+        return;
+    handle_ok(req, res);
+    stream_to_body(*stream, res);
+    callback();
+}
+
+static void handle_streams_id_put(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
+{
+    auto stream = find_stream(req, res, callback, param);
+    if (!stream)
+        return;
+    streams.keep_alive(*stream, query_expires_at(query));
+    if (journal)
+        journal->keep_alive(*stream);
+    update_expiry();
+    handle_ok(req, res);
+    stream_to_body(*stream, res);
+    callback();
+}
+
+static void handle_metrics(http_req& req, http_res& res, http_callback callback,
+    const uri_query& query, boost::string_view param)
+{
+    handle_ok(req, res);
+    res.set(boost::beast::http::field::content_type, "text/plain; version=0.0.4");
+    metrics().write(res.body());
+    res.prepare_payload();
+    callback();
 }
 
-static void handle_safe(http_req& req, http_res& res)
+static const struct
+{
+    const char* pattern;
+    boost::beast::http::verb method;
+    void (*handler)(http_req&, http_res&, http_callback, const uri_query&, boost::string_view);
+} routes[] = {
+    {"/streams", boost::beast::http::verb::post, handle_streams_post},
+    {"/streams", boost::beast::http::verb::get, handle_streams_get},
+    {"/streams", boost::beast::http::verb::put, handle_streams_put},
+    {"/streams/batch", boost::beast::http::verb::post, handle_streams_batch_post},
+    {"/streams/batch", boost::beast::http::verb::put, handle_streams_batch_put},
+    {"/streams/{}", boost::beast::http::verb::get, handle_streams_id_get},
+    {"/streams/{}", boost::beast::http::verb::put, handle_streams_id_put},
+    {"/metrics", boost::beast::http::verb::get, handle_metrics},
+};
+
+static const std::size_t routes_size = sizeof(routes) / sizeof(routes[0]);
+static metric_histogram route_latency[routes_size + 1];
+
+static void handle(http_req& req, http_res& res, http_callback callback, std::size_t& route)
+{
+    auto uri = make_uri(req.target());
+    auto query = make_query(uri.query);
+    bool found = false;
+    for (route = 0; route < routes_size; ++route) {
+        boost::string_view param;
+        if (!uri_match(routes[route].pattern, uri.path, param))
+            continue;
+        found = true;
+        if (routes[route].method == req.method()) {
+            routes[route].handler(req, res, callback, query, param);
+            return;
+        }
+    }
+    if (found)
+        handle_method_not_allowed(req, res);
+    else
+        handle_not_found(req, res);
+    callback();
+}
+
+static void handle_safe(http_req& req, http_res& res, http_callback callback)
 {
     BOOST_LOG_TRIVIAL(trace) << "handle:"
         << " method=" << boost::algorithm::to_lower_copy(std::string(boost::beast::http::to_string(req.method())))
         << " target=" << req.target();
+    struct state
+    {
+        bool called = false;
+        std::size_t route = routes_size;
+        std::chrono::system_clock::time_point started_at = std::chrono::system_clock::now();
+    };
+    auto st = std::make_shared<state>();
+    auto done = [&res, callback, st]() {
+        if (st->called)
+            return;
+        st->called = true;
+        route_latency[st->route].observe(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now() - st->started_at));
+        api_responses[std::min(std::max(res.result_int() / 100, 1u), 5u) - 1].inc();
+        BOOST_LOG_TRIVIAL(trace) << "handle:"
+            << " status=" << res.result_int();
+        callback();
+    };
     try {
-        handle(req, res);
+        handle(req, res, done, st->route);
     } catch (const std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << "client error: " << e.what();
+        if (st->called)
+            return;
         handle_internal_server_error(req, res);
+        done();
     }
-    BOOST_LOG_TRIVIAL(trace) << "handle:"
-        << " status=" << res.result_int();
 }
 
-static void create(const stream_info_map& streams)
+static std::shared_ptr<janus_client> make_janus(boost::asio::io_context& ioc, const janus_instance& instance)
 {
-    if (streams.empty())
-        return;
-    boost::asio::io_context ioc;
-    http_client c(ioc, make_endpoint(client_host, client_port));
-    std::uint64_t session_id;
-    std::uint64_t session_plugin_id;
-    if (!send_session_create(c, session_id) ||
-        !send_session_plugin_attach(c, session_id, session_plugin_id)) {
-        BOOST_LOG_TRIVIAL(error) << "client error";
+    auto transport = client_transport == "ws" ?
+        make_janus_ws_transport(ioc, make_endpoint(client_host, instance.ws_port), client_window) :
+        client_transport == "unix" ?
+        make_janus_unix_transport(ioc, instance.path, client_window) :
+        make_janus_http_transport(ioc, make_endpoint(client_host, instance.port), client_connections);
+    return std::make_shared<janus_client>(ioc, transport, client_streaming_key);
+}
+
+static std::unique_ptr<janus_instance> make_instance(std::uint32_t index)
+{
+    auto instance = std::make_unique<janus_instance>();
+    auto single = client_instances == 1;
+    auto offset = index * client_port_step;
+    auto blocks = (client_rtp_port_max + 1 - client_rtp_port_min) / 4 / client_instances;
+    auto rtp_port_min = static_cast<std::uint16_t>(client_rtp_port_min + index * blocks * 4);
+    auto rtp_port_max = index + 1 == client_instances ? client_rtp_port_max :
+        static_cast<std::uint16_t>(rtp_port_min + blocks * 4 - 1);
+    instance->index = index;
+    instance->conf = single ? client_conf : client_conf + "/" + std::to_string(index);
+    instance->port = client_port + offset;
+    instance->admin_port = client_admin_port + offset;
+    instance->ws_port = client_ws_port + offset;
+    instance->path = single ? client_path : client_path + "." + std::to_string(index);
+    instance->ports = std::make_unique<port_pool>(rtp_port_min, rtp_port_max, rtp_port_min);
+    return instance;
+}
+
+static std::chrono::milliseconds next_backoff(std::chrono::milliseconds backoff)
+{ return std::min<std::chrono::milliseconds>(backoff * 2, timeout_probe_max); }
+
+static bool startup_expired(const janus_instance& instance)
+{ return std::chrono::system_clock::now() - instance.spawned_at >= timeout_startup; }
+
+static void refill(janus_instance& instance)
+{
+    if (instance.state != janus_ready || instance.refilling || instance.warm.size() > client_warm_min)
         return;
-    }
-   for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        if (!send_session_stream_create(c, session_id, session_plugin_id, stream)) {
-            BOOST_LOG_TRIVIAL(error) << "client error";
-            continue;
+    std::vector<stream_info> pending;
+    try {
+        while (instance.warm.size() + pending.size() < client_warm_max) {
+            stream_info stream;
+            do
+                stream.id = gen_stream_id();
+            while (streams.find(stream.id) || creating.count(stream.id));
+            stream.port = instance.ports->allocate();
+            stream.instance = instance.index;
+            creating.insert(stream.id);
+            pending.push_back(stream);
         }
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(warning) << "instance " << instance.index << " warm pool: " << e.what();
     }
+    if (pending.empty())
+        return;
+    instance.refilling = true;
+    auto generation = instance.generation;
+    auto started_at = std::chrono::system_clock::now();
+    instance.janus->stream_create(std::move(pending),
+        [&instance, generation, started_at](const std::vector<std::pair<stream_info, bool>>& results) {
+            report("warm", results, started_at);
+            instance.refilling = false;
+            bool any = false;
+            for (auto& result : results) {
+                creating.erase(result.first.id);
+                if (result.second && instance.generation == generation) {
+                    instance.warm.push_back(result.first);
+                    any = true;
+                } else {
+                    instance.ports->release(result.first.port);
+                }
+            }
+            if (any)
+                refill(instance);
+        }, client_window);
 }
 
-static void remove(const stream_info_map& streams)
+static void ready(janus_instance& instance)
 {
-    if (streams.empty())
-        return;
-    boost::asio::io_context ioc;
-    http_client c(ioc, make_endpoint(client_host, client_port));
-    std::uint64_t session_id;
-    std::uint64_t session_plugin_id;
-    if (!send_session_create(c, session_id) ||
-        !send_session_plugin_attach(c, session_id, session_plugin_id)) {
-        BOOST_LOG_TRIVIAL(error) << "client error";
+    instance.state = janus_ready;
+    auto now = std::chrono::system_clock::now();
+    BOOST_LOG_TRIVIAL(info) << "instance " << instance.index << " is ready after "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(now - instance.spawned_at).count() << "ms";
+    refill(instance);
+    if (instance.detected_at == std::chrono::system_clock::time_point())
         return;
-    }
-    for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        if (!send_session_stream_remove(c, session_id, session_plugin_id, stream)) {
-            BOOST_LOG_TRIVIAL(error) << "client error";
-            continue;
-        }
-    }
+    respawn_duration.observe(std::chrono::duration_cast<std::chrono::microseconds>(now - instance.spawned_at));
+    auto recovery = std::chrono::duration_cast<std::chrono::microseconds>(now - instance.detected_at);
+    recovery_duration.observe(recovery);
+    BOOST_LOG_TRIVIAL(info) << "instance " << instance.index << " restored after " << recovery.count() << "us";
+}
+
+static bool is_managed(std::uint64_t id)
+{ return (id >> 31) == 1; }
+
+// Lists the instance's mountpoints and sends only the difference: creates for
+// registry streams Janus lacks and destroys for mountpoints with our ids that
+// the registry does not have. A port mismatch is both. At most limit of each
+// are sent; the handler gets false unless Janus was brought fully in line.
+static void reconcile(janus_instance& instance, std::size_t limit, janus_handler handler)
+{
+    auto generation = instance.generation;
+    auto started_at = std::chrono::system_clock::now();
+    instance.janus->stream_list(
+        [&instance, generation, limit, handler, started_at](bool ok, const std::vector<stream_info>& mountpoints) {
+            if (!ok || instance.generation != generation) {
+                handler(false);
+                return;
+            }
+            std::unordered_set<std::uint64_t> present;
+            std::unordered_set<std::uint64_t> warm;
+            for (auto& stream : instance.warm)
+                warm.insert(stream.id);
+            std::vector<stream_info> destroys;
+            std::vector<stream_info> creates;
+            for (auto& mountpoint : mountpoints) {
+                auto stream = streams.find(mountpoint.id);
+                if (stream && stream->instance == instance.index && stream->port == mountpoint.port)
+                    present.insert(mountpoint.id);
+                else if (is_managed(mountpoint.id) && !creating.count(mountpoint.id) && !warm.count(mountpoint.id))
+                    destroys.push_back(mountpoint);
+            }
+            for (auto& stream : streams)
+                if (stream.instance == instance.index && !present.count(stream.id))
+                    creates.push_back(stream);
+            bool complete = destroys.size() <= limit && creates.size() <= limit;
+            destroys.resize(std::min(destroys.size(), limit));
+            creates.resize(std::min(creates.size(), limit));
+            BOOST_LOG_SEV(boost::log::trivial::logger::get(),
+                destroys.empty() && creates.empty() ? boost::log::trivial::debug : boost::log::trivial::info)
+                << "reconcile instance " << instance.index << ":"
+                << " mountpoints=" << mountpoints.size()
+                << " create=" << creates.size()
+                << " destroy=" << destroys.size();
+            auto janus = instance.janus;
+            janus->stream_remove(std::move(destroys),
+                [&instance, generation, complete, handler, started_at, janus, creates](
+                    const std::vector<std::pair<stream_info, bool>>& results) {
+                    report("destroy", results, started_at);
+                    reconcile_destroyed.inc(results.size());
+                    bool ok = complete && std::all_of(results.begin(), results.end(),
+                        [](const std::pair<stream_info, bool>& result) { return result.second; });
+                    if (instance.generation != generation) {
+                        handler(false);
+                        return;
+                    }
+                    janus->stream_create(creates,
+                        [ok, handler, started_at](const std::vector<std::pair<stream_info, bool>>& results) {
+                            report("create", results, started_at);
+                            reconcile_created.inc(results.size());
+                            handler(ok && std::all_of(results.begin(), results.end(),
+                                [](const std::pair<stream_info, bool>& result) { return result.second; }));
+                        }, client_window);
+                }, client_window);
+        });
 }
 
-static void spawn()
+static void restore_streams(janus_instance& instance, std::chrono::milliseconds backoff)
+{
+    auto generation = instance.generation;
+    reconcile(instance, std::numeric_limits<std::size_t>::max(),
+        [&instance, generation, backoff](bool ok) {
+            if (instance.generation != generation)
+                return;
+            if (ok || startup_expired(instance)) {
+                if (!ok)
+                    BOOST_LOG_TRIVIAL(error) << "instance " << instance.index << ": streams were not fully restored";
+                ready(instance);
+                return;
+            }
+            instance.probe.expires_from_now(backoff);
+            instance.probe.async_wait(
+                [&instance, generation, backoff](boost::system::error_code ec) {
+                    if (ec == boost::asio::error::operation_aborted || instance.generation != generation)
+                        return;
+                    restore_streams(instance, next_backoff(backoff));
+                });
+        });
+}
+
+// Without the streaming admin key Janus hides our private mountpoints from the
+// list, so only the restore of a freshly spawned instance, which has none, can
+// rely on it; the periodic pass is started only when the key is set.
+static void start_reconcile(janus_instance& instance)
+{
+    instance.reconciler.expires_from_now(timeout_reconcile);
+    instance.reconciler.async_wait(
+        [&instance](boost::system::error_code ec) {
+            if (ec == boost::asio::error::operation_aborted)
+                return;
+            if (instance.state == janus_ready && !instance.reconciling) {
+                instance.reconciling = true;
+                reconcile(instance, max_reconcile_size,
+                    [&instance](bool) { instance.reconciling = false; });
+            }
+            start_reconcile(instance);
+        });
+}
+
+static void restart(janus_instance& instance);
+
+static void start_probe(janus_instance& instance, std::chrono::milliseconds backoff)
+{
+    auto generation = instance.generation;
+    instance.probe.expires_from_now(backoff);
+    instance.probe.async_wait(
+        [&instance, generation, backoff](boost::system::error_code ec) {
+            if (ec == boost::asio::error::operation_aborted || instance.generation != generation)
+                return;
+            instance.janus->ping(
+                [&instance, generation, backoff](bool ok) {
+                    if (instance.generation != generation)
+                        return;
+                    if (ok) {
+                        BOOST_LOG_TRIVIAL(debug) << "instance " << instance.index << " answers, restore streams";
+                        restore_streams(instance, timeout_probe);
+                        return;
+                    }
+                    if (!startup_expired(instance)) {
+                        start_probe(instance, next_backoff(backoff));
+                        return;
+                    }
+                    BOOST_LOG_TRIVIAL(error) << "instance " << instance.index << " did not start in "
+                        << timeout_startup.count() << "s, restart";
+                    restart(instance);
+                });
+        });
+}
+
+// Janus comes up in the background: the instance takes no new streams until a
+// ping succeeds and its streams are re-created, while the API keeps serving.
+static void spawn(janus_instance& instance, std::chrono::system_clock::time_point detected_at)
 {
     auto path = boost::process::search_path("janus");
-    BOOST_LOG_TRIVIAL(debug) << "spawn " << path.string();
-    process = boost::process::child(path, std::string("--configs-folder=") + client_conf,
+    BOOST_LOG_TRIVIAL(debug) << "spawn " << path.string() << " instance " << instance.index;
+    ++instance.generation;
+    instance.state = janus_stopped;
+    instance.probe.cancel();
+    for (auto& stream : instance.warm)
+        instance.ports->release(stream.port);
+    instance.warm.clear();
+    if (instance.janus)
+        instance.janus->reset();
+    if (instance.admin)
+        instance.admin->close();
+    instance.process = boost::process::child(path, std::string("--configs-folder=") + instance.conf,
         boost::process::std_out > boost::process::null,
         boost::process::std_err > boost::process::null);
-    std::size_t retry = 0;
-    for ( ; retry < retries; ++retry) {
-        try {
-            create(streams);
-            break;
-        } catch (const std::exception& e) {
-            if (retry == retries)
-                throw e;
-        }
-        std::this_thread::sleep_for(timeout_retries);
-    }
+    instance.state = janus_starting;
+    instance.health_failures = 0;
+    instance.spawned_at = std::chrono::system_clock::now();
+    instance.detected_at = detected_at;
+    start_probe(instance, timeout_probe);
 }
 
-static void respawn()
+static void respawn(janus_instance& instance, std::chrono::system_clock::time_point detected_at)
 {
     bool dead = false;
     try {
-        dead = process.wait_for(std::chrono::seconds(0));
+        dead = !instance.process.running();
     } catch (const std::exception&) {
         dead = true;
     }
-    if (dead)
-        spawn();
+    if (!dead)
+        return;
+    BOOST_LOG_TRIVIAL(warning) << "instance " << instance.index << " is dead"
+        << " (exit code " << instance.process.exit_code() << "), respawn";
+    instance.respawns.inc();
+    spawn(instance, detected_at);
+}
+
+static void restart(janus_instance& instance)
+{
+    auto detected_at = std::chrono::system_clock::now();
+    try {
+        instance.process.terminate();
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "system error: " << e.what();
+    }
+    instance.respawns.inc();
+    try {
+        spawn(instance, detected_at);
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "system error: " << e.what();
+    }
 }
 
+static void check_health(janus_instance& instance)
+{
+    nlohmann::json req_json;
+    req_json["janus"] = "ping";
+    req_json["transaction"] = gen_uid();
+    req_json["admin_secret"] = client_admin_secret;
+    auto req = std::make_shared<http_req>(boost::beast::http::verb::post, "/admin", 11);
+    auto res = std::make_shared<http_res>();
+    req->set(boost::beast::http::field::host, client_host);
+    req->set(boost::beast::http::field::content_type, "application/json");
+    req->keep_alive(true);
+    req->body() = req_json.dump();
+    req->prepare_payload();
+    auto generation = instance.generation;
+    auto started_at = std::chrono::system_clock::now();
+    instance.health_pending = true;
+    (*instance.admin)(*req, *res,
+        [&instance, generation, req, res, started_at](boost::system::error_code ec) {
+            instance.health_pending = false;
+            if (instance.generation != generation || instance.state != janus_ready)
+                return;
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now() - started_at);
+            instance.admin_latency.observe(latency);
+            bool ok = false;
+            try {
+                ok = !ec && res->result() == boost::beast::http::status::ok &&
+                    nlohmann::json::parse(res->body()).value("janus", "") == "pong";
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "parse error: " << e.what();
+            }
+            if (ok && latency <= client_health_slo) {
+                instance.health_failures = 0;
+                return;
+            }
+            instance.unhealthy.inc();
+            ++instance.health_failures;
+            BOOST_LOG_TRIVIAL(warning) << "instance " << instance.index << " health check "
+                << (ok ? "is slow" : "failed") << ":"
+                << " latency=" << latency.count() << "us"
+                << " failures=" << instance.health_failures;
+            if (instance.health_failures < client_health_failures)
+                return;
+            BOOST_LOG_TRIVIAL(error) << "instance " << instance.index << " is unhealthy, restart";
+            restart(instance);
+        });
+}
+
+static void start_health(janus_instance& instance)
+{
+    instance.health.expires_from_now(timeout_health);
+    instance.health.async_wait(
+        [&instance](boost::system::error_code ec) {
+            if (ec == boost::asio::error::operation_aborted)
+                return;
+            if (instance.state == janus_ready && !instance.health_pending)
+                check_health(instance);
+            start_health(instance);
+        });
+}
+
+static void respawn()
+{
+    auto detected_at = std::chrono::system_clock::now();
+    for (auto& instance : instances) {
+        try {
+            respawn(*instance, detected_at);
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "system error: " << e.what();
+        }
+    }
+}
+
+static void start_children()
+{
+    children.async_wait(
+        [](boost::system::error_code ec, int) {
+            if (ec == boost::asio::error::operation_aborted)
+                return;
+            respawn();
+            start_children();
+        });
+}
+
+// SIGCHLD restarts a crashed Janus right away; the timer only picks up spawns
+// that failed and left no child behind to signal.
 static void start_deadline()
 {
     deadline.expires_from_now(timeout_loop);
@@ -419,97 +1170,359 @@ static void start_deadline()
         [](boost::system::error_code ec) {
             if (ec == boost::asio::error::operation_aborted)
                 return;
-            try {
-                respawn();
-            } catch (const std::exception& e) {
-                BOOST_LOG_TRIVIAL(error) << "system error: " << e.what();
-            }
-            try {
-                remove(expired(streams));
-            } catch (const std::exception& e) {
-                BOOST_LOG_TRIVIAL(error) << "client error: " << e.what();
-            }
+            respawn();
             start_deadline();
         });
 }
 
-static void work()
+static void start_expiry()
+{
+    expiry.expires_at(streams.next_expiry());
+    expiry.async_wait(
+        [](boost::system::error_code ec) {
+            if (ec == boost::asio::error::operation_aborted)
+                return;
+            auto started_at = std::chrono::system_clock::now();
+            auto expires = streams.expired(started_at);
+            expiry_reaped.inc(expires.size());
+            for (auto& stream : expires) {
+                instance_of(stream).ports->release(stream.port);
+                if (journal)
+                    journal->erase(stream.id);
+            }
+            remove(std::move(expires));
+            expiry_duration.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now() - started_at));
+            start_expiry();
+        });
+}
+
+static void restore()
+{
+    auto started_at = std::chrono::system_clock::now();
+    journal = std::make_unique<stream_journal>(ioc, registry_dir, streams);
+    auto records = journal->load(streams);
+    auto dropped = streams.expired(started_at).size();
+    std::vector<std::uint64_t> lost;
+    for (auto& stream : streams)
+        if (stream.instance >= instances.size() || !instance_of(stream).ports->reserve(stream.port))
+            lost.push_back(stream.id);
+    for (auto id : lost) {
+        BOOST_LOG_TRIVIAL(warning) << "registry: drop stream " << id
+            << ", instance is gone or port is out of range or taken";
+        streams.erase(id);
+    }
+    journal->compact();
+    restore_duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now() - started_at);
+    BOOST_LOG_TRIVIAL(info) << "registry: restored streams=" << streams.size()
+        << " records=" << records
+        << " expired=" << dropped
+        << " dropped=" << lost.size()
+        << " time=" << restore_duration.count() << "us";
+}
+
+static void init_metrics(const http_server& server)
+{
+    auto& m = metrics();
+    for (std::size_t i = 0; i <= routes_size; ++i) {
+        auto labels = i < routes_size ?
+            std::string("route=\"") + routes[i].pattern + "\",method=\"" +
+                boost::algorithm::to_lower_copy(std::string(boost::beast::http::to_string(routes[i].method))) + "\"" :
+            std::string("route=\"other\",method=\"\"");
+        m.add("janus_manager_api_request_duration_seconds", "API request latency.", labels, route_latency[i]);
+    }
+    m.add("janus_manager_log_dropped_total", "Log records dropped on a full queue.", "", log_dropped);
+    m.add("janus_manager_log_blocked_total", "Times logging waited on a full queue.", "", log_blocked);
+    m.add("janus_manager_api_coalesced_total", "Stream creations that joined one already in flight for the host.", "",
+        api_coalesced);
+    for (std::size_t i = 0; i < 5; ++i)
+        m.add("janus_manager_api_responses_total", "API responses by status class.",
+            "code=\"" + std::to_string(i + 1) + "xx\"", api_responses[i]);
+    for (auto& instance : instances) {
+        auto labels = "instance=\"" + std::to_string(instance->index) + "\"";
+        auto& ports = *instance->ports;
+        m.add("janus_manager_respawns_total", "Janus respawns.", labels, instance->respawns);
+        m.add("janus_manager_health_failures_total", "Failed or slow admin API health checks.", labels,
+            instance->unhealthy);
+        m.add("janus_manager_admin_request_duration_seconds", "Admin API ping latency.", labels,
+            instance->admin_latency);
+        m.add("janus_manager_port_blocks", "RTP port blocks in the pool.", labels,
+            [&ports]() { return static_cast<double>(ports.size()); });
+        m.add("janus_manager_port_blocks_used", "RTP port blocks in use.", labels,
+            [&ports]() { return static_cast<double>(ports.used()); });
+        auto& warm = instance->warm;
+        m.add("janus_manager_warm_mountpoints", "Pre-created mountpoints waiting for a host.", labels,
+            [&warm]() { return static_cast<double>(warm.size()); });
+        auto& state = instance->state;
+        m.add("janus_manager_instance_ready", "Whether the Janus instance is up and its streams restored.", labels,
+            [&state]() { return state == janus_ready ? 1.0 : 0.0; });
+    }
+    m.add("janus_manager_respawn_duration_seconds", "Time to respawn Janus and restore streams.", "",
+        respawn_duration);
+    m.add("janus_manager_recovery_duration_seconds", "Time from detecting a Janus exit to its streams being restored.", "",
+        recovery_duration);
+    m.add("janus_manager_expiry_duration_seconds", "Expiry sweep duration.", "", expiry_duration);
+    m.add("janus_manager_expiry_reaped_total", "Streams removed by expiry.", "", expiry_reaped);
+    m.add("janus_manager_reconcile_created_total", "Mountpoints created by the reconciler.", "", reconcile_created);
+    m.add("janus_manager_reconcile_destroyed_total", "Mountpoints destroyed by the reconciler.", "",
+        reconcile_destroyed);
+    m.add("janus_manager_streams", "Streams in the registry.", "",
+        []() { return static_cast<double>(streams.size()); });
+    m.add("janus_manager_api_sessions", "Open API sessions.", "",
+        [&server]() { return static_cast<double>(server.sessions()); });
+    m.add("janus_manager_startup_duration_seconds", "Time from process start to serving.", "",
+        []() { return startup_duration.count() / 1e6; });
+    m.add("janus_manager_restore_duration_seconds", "Time to load the persisted registry.", "",
+        []() { return restore_duration.count() / 1e6; });
+    m.add("janus_manager_journal_records", "Records in the registry journal since the last snapshot.", "",
+        []() { return journal ? static_cast<double>(journal->records()) : 0.0; });
+}
+
+// A socket left by a previous run is removed; anything else at the path is
+// not ours to delete.
+static bool remove_socket(const std::string& path)
+{
+    struct stat st;
+    if (::lstat(path.c_str(), &st)) {
+        if (errno == ENOENT)
+            return true;
+        BOOST_LOG_TRIVIAL(fatal) << "server error: stat " << path << ": " << std::strerror(errno);
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        BOOST_LOG_TRIVIAL(fatal) << "server error: " << path << " exists and is not a socket";
+        return false;
+    }
+    if (::unlink(path.c_str())) {
+        BOOST_LOG_TRIVIAL(fatal) << "server error: unlink " << path << ": " << std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+static int work()
 {
     BOOST_LOG_TRIVIAL(info) << "init";
     BOOST_LOG_TRIVIAL(info) << "client conf: " << client_conf;
     BOOST_LOG_TRIVIAL(info) << "client host: " << client_host;
     BOOST_LOG_TRIVIAL(info) << "client port: " << client_port;
     BOOST_LOG_TRIVIAL(info) << "client admin port: " << client_admin_port;
+    BOOST_LOG_TRIVIAL(info) << "client streaming key: " << (client_streaming_key.empty() ? "none, periodic reconcile is off" : "set");
+    BOOST_LOG_TRIVIAL(info) << "client health failures: " << client_health_failures;
+    BOOST_LOG_TRIVIAL(info) << "client health slo: " << client_health_slo.count() << "ms";
+    BOOST_LOG_TRIVIAL(info) << "client ws port: " << client_ws_port;
+    BOOST_LOG_TRIVIAL(info) << "client transport: " << client_transport;
+    BOOST_LOG_TRIVIAL(info) << "client path: " << client_path;
+    BOOST_LOG_TRIVIAL(info) << "client connections: " << client_connections;
+    BOOST_LOG_TRIVIAL(info) << "client window: " << client_window;
+    BOOST_LOG_TRIVIAL(info) << "client instances: " << client_instances;
+    BOOST_LOG_TRIVIAL(info) << "client port step: " << client_port_step;
+    BOOST_LOG_TRIVIAL(info) << "client warm pool: " << client_warm_min << "-" << client_warm_max;
     BOOST_LOG_TRIVIAL(info) << "client rtp port min: " << client_rtp_port_min;
     BOOST_LOG_TRIVIAL(info) << "client rtp port max: " << client_rtp_port_max;
     BOOST_LOG_TRIVIAL(info) << "server host: " << server_host;
     BOOST_LOG_TRIVIAL(info) << "server port: " << server_port;
+    BOOST_LOG_TRIVIAL(info) << "server path: " << server_path;
+    BOOST_LOG_TRIVIAL(info) << "server max sessions: " << server_max_sessions;
+    BOOST_LOG_TRIVIAL(info) << "registry dir: " << registry_dir;
     BOOST_LOG_TRIVIAL(info) << "work";
-    spawn();
+    if (!server_path.empty() && !remove_socket(server_path))
+        return 1;
+    for (std::uint32_t i = 0; i < client_instances; ++i) {
+        instances.push_back(make_instance(i));
+        auto& instance = *instances.back();
+        BOOST_LOG_TRIVIAL(info) << "instance " << i << ":"
+            << " conf=" << instance.conf
+            << " port=" << instance.port
+            << " admin_port=" << instance.admin_port
+            << " ws_port=" << instance.ws_port
+            << " path=" << instance.path
+            << " rtp_ports=" << instance.ports->min_port() << "-" << instance.ports->max_port();
+    }
+    if (!registry_dir.empty())
+        restore();
+    for (auto& instance : instances) {
+        instance->janus = make_janus(ioc, *instance);
+        instance->janus->start();
+        instance->admin = std::make_shared<http_client>(ioc, make_endpoint(client_host, instance->admin_port));
+        spawn(*instance, std::chrono::system_clock::time_point());
+        start_health(*instance);
+        if (!client_streaming_key.empty())
+            start_reconcile(*instance);
+    }
+    start_children();
     start_deadline();
-    http_server s(ioc, make_endpoint(server_host, server_port), handle_safe);
+    start_expiry();
+    boost::asio::generic::stream_protocol::endpoint ep = make_endpoint(server_host, server_port);
+    if (!server_path.empty())
+        ep = boost::asio::local::stream_protocol::endpoint(server_path);
+    http_server s(ioc, ep, handle_safe, server_max_sessions);
+    init_metrics(s);
+    startup_duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now() - started_at);
+    BOOST_LOG_TRIVIAL(info) << "serving after " << startup_duration.count() << "us";
     try {
         ioc.run();
     } catch (const std::exception& e) {
         BOOST_LOG_TRIVIAL(fatal) << "server error: " << e.what();
     }
+    journal.reset();
     BOOST_LOG_TRIVIAL(info) << "done";
+    return 0;
 }
 
-static void init(int argc, char* argv[])
+static const std::size_t log_queue_size = 65536;
+
+struct log_drop_on_overflow : boost::log::sinks::drop_on_overflow
 {
-    std::srand(std::time(nullptr));
-    boost::log::register_simple_formatter_factory<boost::log::trivial::severity_level, char>("Severity");
-    auto sink0 = boost::log::add_console_log(std::cerr,
-        boost::log::keywords::format = "[%TimeStamp%][%Severity%]: %Message%");
-    sink0->set_filter(boost::log::trivial::severity >= severity);
-    auto sink1 = boost::log::add_file_log(
-        boost::log::keywords::format = "[%TimeStamp%][%Severity%]: %Message%",
-        boost::log::keywords::file_name = std::string("/var/log/") + application(argv[0]) + ".log.%N",
+    template <typename Lock>
+    bool on_overflow(const boost::log::record_view& rec, Lock& lock)
+    {
+        log_dropped.inc();
+        return boost::log::sinks::drop_on_overflow::on_overflow(rec, lock);
+    }
+};
+
+struct log_block_on_overflow : boost::log::sinks::block_on_overflow
+{
+    template <typename Lock>
+    bool on_overflow(const boost::log::record_view& rec, Lock& lock)
+    {
+        log_blocked.inc();
+        return boost::log::sinks::block_on_overflow::on_overflow(rec, lock);
+    }
+};
+
+// Records are formatted and written by the sinks' own threads, so a slow disk
+// or terminal does not stall the event loop; when a queue is full the record
+// is dropped or the loop waits, as set by -y.
+template <typename Overflow>
+static void add_log_sinks(const char* argv0)
+{
+    using queue = boost::log::sinks::bounded_fifo_queue<log_queue_size, Overflow>;
+    using console_sink = boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend, queue>;
+    using file_sink = boost::log::sinks::asynchronous_sink<boost::log::sinks::text_file_backend, queue>;
+    auto format = boost::log::parse_formatter("[%TimeStamp%][%Severity%]: %Message%");
+    auto console = boost::make_shared<boost::log::sinks::text_ostream_backend>();
+    console->add_stream(boost::shared_ptr<std::ostream>(&std::cerr, boost::null_deleter()));
+    auto sink0 = boost::make_shared<console_sink>(console);
+    sink0->set_formatter(format);
+    auto file = boost::make_shared<boost::log::sinks::text_file_backend>(
+        boost::log::keywords::file_name = std::string("/var/log/") + application(argv0) + ".log.%N",
         boost::log::keywords::rotation_size = 1024 * 1024 * 10,
-        boost::log::keywords::auto_flush = true,
         boost::log::keywords::open_mode = std::ios_base::app);
-    sink1->set_filter(boost::log::trivial::severity >= severity);
+    file->auto_flush(true);
+    auto sink1 = boost::make_shared<file_sink>(file);
+    sink1->set_formatter(format);
+    boost::log::core::get()->add_sink(sink0);
+    boost::log::core::get()->add_sink(sink1);
+    stop_logging = [sink0, sink1]() {
+        boost::log::core::get()->remove_all_sinks();
+        sink0->stop();
+        sink0->flush();
+        sink1->stop();
+        sink1->flush();
+    };
+}
+
+static void init(int argc, char* argv[])
+{
+    boost::log::register_simple_formatter_factory<boost::log::trivial::severity_level, char>("Severity");
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= severity);
+    if (log_overflow == "block")
+        add_log_sinks<log_block_on_overflow>(argv[0]);
+    else
+        add_log_sinks<log_drop_on_overflow>(argv[0]);
     boost::log::add_common_attributes();
 }
 
+static void fini()
+{
+    if (stop_logging)
+        stop_logging();
+}
+
 static void usage(int argc, char* argv[])
 {
     std::printf("Usage: %s [OPTIONS]", application(argv[0]).c_str());
     std::printf("\n  -h help");
     std::printf("\n  -v verbose");
+    std::printf("\n  -y arg (%s) log queue overflow policy (drop, block)", log_overflow.c_str());
     std::printf("\n  -d arg (%s) client conf", client_conf.c_str());
     std::printf("\n  -q arg (%u) client port", client_port);
+    std::printf("\n  -a arg (%u) client admin port", client_admin_port);
+    std::printf("\n  -e arg (%s) client admin secret", client_admin_secret.c_str());
+    std::printf("\n  -z arg (%s) client streaming plugin admin key, periodic reconcile needs it", client_streaming_key.c_str());
+    std::printf("\n  -f arg (%zu) client failed health checks before restart", client_health_failures);
+    std::printf("\n  -g arg (%lld) client health check latency slo, ms", static_cast<long long>(client_health_slo.count()));
+    std::printf("\n  -o arg (%u) client ws port", client_ws_port);
+    std::printf("\n  -u arg (%s) client unix socket path", client_path.c_str());
+    std::printf("\n  -t arg (%s) client transport (http, ws, unix)", client_transport.c_str());
+    std::printf("\n  -j arg (%zu) client connections", client_connections);
+    std::printf("\n  -w arg (%zu) client window", client_window);
+    std::printf("\n  -i arg (%zu) client instances, each in <conf>/<index> with ports shifted by index * step", client_instances);
+    std::printf("\n  -k arg (%u) client port step between instances", client_port_step);
+    std::printf("\n  -b arg (%zu) client warm pool low watermark, refill at or below it", client_warm_min);
+    std::printf("\n  -m arg (%zu) client warm pool high watermark, 0 to disable", client_warm_max);
     std::printf("\n  -n arg (%u) client min rtp port", client_rtp_port_min);
     std::printf("\n  -x arg (%u) client max rtp port", client_rtp_port_max);
     std::printf("\n  -l arg (%s) server host", server_host.c_str());
     std::printf("\n  -p arg (%u) server port", server_port);
+    std::printf("\n  -s arg (%s) server unix socket path", server_path.c_str());
+    std::printf("\n  -c arg (%zu) server max sessions", server_max_sessions);
+    std::printf("\n  -r arg (%s) registry dir, streams are kept in memory only if empty", registry_dir.c_str());
     std::printf("\n");
     std::printf("\n");
     std::exit(0);
 }
 
+#ifndef JANUS_MANAGER_NO_MAIN
 int main(int argc, char* argv[])
 {
     int ret;
-    while ((ret = getopt(argc, argv, "vd:q:n:x:l:p:h")) != -1) {
+    while ((ret = getopt(argc, argv, "vy:d:q:a:e:z:f:g:o:u:t:j:w:i:k:b:m:n:x:l:p:s:c:r:h")) != -1) {
         switch (ret) {
         case 'v': severity = boost::log::trivial::trace; break;
+        case 'y': log_overflow = optarg; break;
         case 'd': client_conf = optarg; break;
         case 'q': client_port = std::stoul(optarg); break;
+        case 'a': client_admin_port = std::stoul(optarg); break;
+        case 'e': client_admin_secret = optarg; break;
+        case 'z': client_streaming_key = optarg; break;
+        case 'f': client_health_failures = std::stoul(optarg); break;
+        case 'g': client_health_slo = std::chrono::milliseconds(std::stoul(optarg)); break;
+        case 'o': client_ws_port = std::stoul(optarg); break;
+        case 'u': client_path = optarg; break;
+        case 't': client_transport = optarg; break;
+        case 'j': client_connections = std::stoul(optarg); break;
+        case 'w': client_window = std::stoul(optarg); break;
+        case 'i': client_instances = std::stoul(optarg); break;
+        case 'k': client_port_step = std::stoul(optarg); break;
+        case 'b': client_warm_min = std::stoul(optarg); break;
+        case 'm': client_warm_max = std::stoul(optarg); break;
         case 'n': client_rtp_port_min = std::stoul(optarg); break;
         case 'x': client_rtp_port_max = std::stoul(optarg); break;
         case 'l': server_host = optarg; break;
         case 'p': server_port = std::stoul(optarg); break;
+        case 's': server_path = optarg; break;
+        case 'c': server_max_sessions = std::stoul(optarg); break;
+        case 'r': registry_dir = optarg; break;
         case 'h':
         default:
             usage(argc, argv);
             break;
         }
     }
-    if (optind != argc)
+    if (optind != argc || (client_transport != "http" && client_transport != "ws" && client_transport != "unix") ||
+        (log_overflow != "drop" && log_overflow != "block") ||
+        !client_instances || client_instances > max_janus_instances || client_warm_min > client_warm_max ||
+        client_rtp_port_max < client_rtp_port_min ||
+        (client_rtp_port_max + 1u - client_rtp_port_min) / 4 < client_instances)
         usage(argc, argv);
     init(argc, argv);
-    work();
-    return 0;
+    auto res = work();
+    fini();
+    return res;
 }
+#endif
@@ -0,0 +1,122 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+const std::array<std::uint64_t, 19> metric_histogram::bounds = {{
+    10, 25, 50, 100, 250, 500,
+    1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000}};
+
+void metric_histogram::observe(std::chrono::microseconds value)
+{
+    auto us = static_cast<std::uint64_t>(std::max<std::chrono::microseconds::rep>(value.count(), 0));
+    auto i = std::lower_bound(bounds.begin(), bounds.end(), us) - bounds.begin();
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+}
+
+std::uint64_t metric_histogram::count() const
+{
+    std::uint64_t res = 0;
+    for (const auto& bucket : buckets_)
+        res += bucket.load(std::memory_order_relaxed);
+    return res;
+}
+
+std::uint64_t metric_histogram::sum() const
+{
+    return sum_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t metric_histogram::bucket(std::size_t i) const
+{
+    return buckets_[i].load(std::memory_order_relaxed);
+}
+
+static void append_double(std::string& res, double value)
+{
+    char buf[32];
+    res.append(buf, std::snprintf(buf, sizeof(buf), "%.9g", value));
+}
+
+static void append_sample(std::string& res, const std::string& name, const char* suffix,
+    const std::string& labels, const std::string& le, double value)
+{
+    res += name;
+    res += suffix;
+    if (!labels.empty() || !le.empty()) {
+        res += '{';
+        res += labels;
+        if (!labels.empty() && !le.empty())
+            res += ',';
+        if (!le.empty()) {
+            res += "le=\"";
+            res += le;
+            res += '"';
+        }
+        res += '}';
+    }
+    res += ' ';
+    append_double(res, value);
+    res += '\n';
+}
+
+void metric_registry::add(const std::string& name, const std::string& help, const std::string& labels,
+    const metric_counter& counter)
+{
+    at(name, help, "counter").counters.emplace_back(labels, &counter);
+}
+
+void metric_registry::add(const std::string& name, const std::string& help, const std::string& labels,
+    const metric_histogram& histogram)
+{
+    at(name, help, "histogram").histograms.emplace_back(labels, &histogram);
+}
+
+void metric_registry::add(const std::string& name, const std::string& help, const std::string& labels,
+    metric_gauge gauge)
+{
+    at(name, help, "gauge").gauges.emplace_back(labels, gauge);
+}
+
+void metric_registry::write(std::string& res) const
+{
+    for (const auto& f : families_) {
+        const auto& name = f.first;
+        res += "# HELP " + name + " " + f.second.help + "\n";
+        res += "# TYPE " + name + " " + f.second.type + "\n";
+        for (const auto& c : f.second.counters)
+            append_sample(res, name, "", c.first, "", c.second->value());
+        for (const auto& g : f.second.gauges)
+            append_sample(res, name, "", g.first, "", g.second());
+        for (const auto& h : f.second.histograms) {
+            std::uint64_t count = 0;
+            for (std::size_t i = 0; i < metric_histogram::bounds.size(); ++i) {
+                count += h.second->bucket(i);
+                char le[32];
+                std::snprintf(le, sizeof(le), "%g", metric_histogram::bounds[i] / 1e6);
+                append_sample(res, name, "_bucket", h.first, le, count);
+            }
+            count += h.second->bucket(metric_histogram::bounds.size());
+            append_sample(res, name, "_bucket", h.first, "+Inf", count);
+            append_sample(res, name, "_sum", h.first, "", h.second->sum() / 1e6);
+            append_sample(res, name, "_count", h.first, "", count);
+        }
+    }
+}
+
+metric_registry::family& metric_registry::at(const std::string& name, const std::string& help,
+    const char* type)
+{
+    auto& f = families_[name];
+    f.help = help;
+    f.type = type;
+    return f;
+}
+
+metric_registry& metrics()
+{
+    static metric_registry registry;
+    return registry;
+}
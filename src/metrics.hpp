@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class metric_counter
+{
+public:
+    void inc(std::uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<std::uint64_t> value_{0};
+};
+
+class metric_histogram
+{
+public:
+    static const std::array<std::uint64_t, 19> bounds;
+    void observe(std::chrono::microseconds value);
+    std::uint64_t count() const;
+    std::uint64_t sum() const;
+    std::uint64_t bucket(std::size_t i) const;
+private:
+    std::array<std::atomic<std::uint64_t>, 20> buckets_{};
+    std::atomic<std::uint64_t> sum_{0};
+};
+
+using metric_gauge = std::function<double()>;
+
+class metric_registry
+{
+public:
+    void add(const std::string& name, const std::string& help, const std::string& labels,
+        const metric_counter& counter);
+    void add(const std::string& name, const std::string& help, const std::string& labels,
+        const metric_histogram& histogram);
+    void add(const std::string& name, const std::string& help, const std::string& labels,
+        metric_gauge gauge);
+    void write(std::string& res) const;
+private:
+    struct family
+    {
+        std::string help;
+        const char* type;
+        std::vector<std::pair<std::string, const metric_counter*>> counters;
+        std::vector<std::pair<std::string, const metric_histogram*>> histograms;
+        std::vector<std::pair<std::string, metric_gauge>> gauges;
+    };
+    family& at(const std::string& name, const std::string& help, const char* type);
+    std::map<std::string, family> families_;
+};
+
+metric_registry& metrics();
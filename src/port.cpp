@@ -0,0 +1,109 @@
+#include "port.hpp"
+
+#include <stdexcept>
+
+// Free 4-port blocks form a FIFO list threaded through prev_/next_ (size_ is
+// the sentinel), so recently released blocks are reused last.
+
+port_pool::port_pool(std::uint16_t min_port, std::uint16_t max_port, std::uint16_t port)
+    : min_port_(min_port), max_port_(max_port)
+{
+    if (!min_port || min_port > max_port || port < min_port || port > max_port ||
+        (max_port + 1 - min_port) % 4 ||
+        (max_port + 1 - port) % 4)
+        throw std::out_of_range("invalid range of ports");
+    size_ = (max_port + 1 - min_port) / 4;
+    prev_.resize(size_ + 1, size_);
+    next_.resize(size_ + 1, size_);
+    used_.resize(size_, false);
+    for (std::uint32_t i = block(port); i < size_; ++i)
+        link(i);
+    for (std::uint32_t i = 0; i < block(port); ++i)
+        link(i);
+}
+
+std::uint16_t port_pool::allocate()
+{
+    std::uint32_t i = next_[size_];
+    if (i == size_)
+        throw std::out_of_range("no more ports!");
+    unlink(i);
+    used_[i] = true;
+    ++used_size_;
+    return min_port_ + i * 4;
+}
+
+bool port_pool::reserve(std::uint16_t port)
+{
+    if (port < min_port_ || port > max_port_ || (port - min_port_) % 4)
+        return false;
+    std::uint32_t i = block(port);
+    if (used_[i])
+        return false;
+    unlink(i);
+    used_[i] = true;
+    ++used_size_;
+    return true;
+}
+
+void port_pool::release(std::uint16_t port)
+{
+    if (!has(port))
+        return;
+    std::uint32_t i = block(port);
+    used_[i] = false;
+    --used_size_;
+    link(i);
+}
+
+bool port_pool::has(std::uint16_t port) const
+{
+    if (port < min_port_ || port > max_port_ || (port - min_port_) % 4)
+        return false;
+    return used_[block(port)];
+}
+
+std::uint16_t port_pool::min_port() const
+{
+    return min_port_;
+}
+
+std::uint16_t port_pool::max_port() const
+{
+    return max_port_;
+}
+
+std::size_t port_pool::size() const
+{
+    return size_;
+}
+
+std::size_t port_pool::used() const
+{
+    return used_size_;
+}
+
+double port_pool::occupancy() const
+{
+    return size_ ? static_cast<double>(used_size_) / size_ : 1.0;
+}
+
+std::uint32_t port_pool::block(std::uint16_t port) const
+{
+    return (port - min_port_) / 4;
+}
+
+void port_pool::link(std::uint32_t block)
+{
+    std::uint32_t tail = prev_[size_];
+    prev_[block] = tail;
+    next_[block] = size_;
+    next_[tail] = block;
+    prev_[size_] = block;
+}
+
+void port_pool::unlink(std::uint32_t block)
+{
+    next_[prev_[block]] = next_[block];
+    prev_[next_[block]] = prev_[block];
+}
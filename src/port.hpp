@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class port_pool
+{
+public:
+    port_pool(std::uint16_t min_port, std::uint16_t max_port, std::uint16_t port);
+    std::uint16_t allocate();
+    bool reserve(std::uint16_t port);
+    void release(std::uint16_t port);
+    bool has(std::uint16_t port) const;
+    std::uint16_t min_port() const;
+    std::uint16_t max_port() const;
+    std::size_t size() const;
+    std::size_t used() const;
+    double occupancy() const;
+private:
+    std::uint32_t block(std::uint16_t port) const;
+    void link(std::uint32_t block);
+    void unlink(std::uint32_t block);
+    std::uint16_t min_port_;
+    std::uint16_t max_port_;
+    std::vector<std::uint32_t> prev_;
+    std::vector<std::uint32_t> next_;
+    std::vector<bool> used_;
+    std::size_t size_;
+    std::size_t used_size_ = 0;
+};
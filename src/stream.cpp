@@ -1,71 +1,196 @@
 #include "stream.hpp"
+#include "hash.hpp"
 
-static bool has_id(const stream_info_map& streams, std::uint32_t id)
+stream_info* stream_registry::find(std::uint64_t id)
 {
-    return streams.count(id);
+    auto it = ids_.find(id);
+    return it != ids_.end() ? &slots_[it->second] : nullptr;
 }
 
-static std::uint32_t gen_id(const stream_info_map& streams)
+const stream_info* stream_registry::find(std::uint64_t id) const
 {
-    for (std::uint32_t res = std::rand(); ; res = std::rand()) {
-        res |= 0x80000000;
-        if (res && !has_id(streams, res))
-            return res;
+    auto it = ids_.find(id);
+    return it != ids_.end() ? &slots_[it->second] : nullptr;
+}
+
+stream_info* stream_registry::find_host(const std::string& host)
+{
+    auto it = hosts_.find(host);
+    return it != hosts_.end() ? &slots_[it->second] : nullptr;
+}
+
+const stream_info* stream_registry::find_host(const std::string& host) const
+{
+    auto it = hosts_.find(host);
+    return it != hosts_.end() ? &slots_[it->second] : nullptr;
+}
+
+stream_info* stream_registry::find_port(std::uint16_t port)
+{
+    auto it = ports_.find(port);
+    return it != ports_.end() ? &slots_[it->second] : nullptr;
+}
+
+const stream_info* stream_registry::find_port(std::uint16_t port) const
+{
+    auto it = ports_.find(port);
+    return it != ports_.end() ? &slots_[it->second] : nullptr;
+}
+
+stream_info& stream_registry::insert(const stream_info& stream)
+{
+    if (!stream.id)
+        throw std::invalid_argument("invalid stream identificator");
+    erase(stream.id);
+    std::uint32_t slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+        slots_[slot] = stream;
+    } else {
+        slot = slots_.size();
+        slots_.push_back(stream);
     }
-    throw std::out_of_range("no more identificators!");
+    ids_[stream.id] = slot;
+    hosts_[stream.host] = slot;
+    ports_[stream.port] = slot;
+    expires_.emplace(stream.expires_at, stream.id);
+    return slots_[slot];
+}
+
+bool stream_registry::erase(std::uint64_t id)
+{
+    auto it = ids_.find(id);
+    if (it == ids_.end())
+        return false;
+    std::uint32_t slot = it->second;
+    auto& stream = slots_[slot];
+    ids_.erase(it);
+    auto host = hosts_.find(stream.host);
+    if (host != hosts_.end() && host->second == slot)
+        hosts_.erase(host);
+    auto port = ports_.find(stream.port);
+    if (port != ports_.end() && port->second == slot)
+        ports_.erase(port);
+    expires_.erase(std::make_pair(stream.expires_at, stream.id));
+    stream = stream_info();
+    free_.push_back(slot);
+    return true;
+}
+
+void stream_registry::reserve(std::size_t size)
+{
+    slots_.reserve(size);
+    ids_.reserve(size);
+    hosts_.reserve(size);
+    ports_.reserve(size);
 }
 
-static bool has_port(const stream_info_map& streams, std::uint16_t port)
+void stream_registry::keep_alive(stream_info& stream, std::chrono::system_clock::time_point expires_at)
 {
-    for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        if (stream.port == port)
-            return true;
+    if (find(stream.id) != &stream) {
+        ::keep_alive(stream, expires_at);
+        return;
     }
-    return false;
-}
-
-static std::uint16_t gen_port(const stream_info_map& streams,
-    std::uint16_t min_port, std::uint16_t max_port, std::uint16_t& port)
-{
-    if ((max_port + 1 - min_port) % 4 ||
-        (max_port + 1 - port) % 4)
-        throw std::out_of_range("invalid range of ports");
-    for (std::uint32_t res = port; res < max_port; res += 4) {
-        if (res && !has_port(streams, res)) {
-            port += 4;
-            if (port > max_port)
-                port = min_port;
-            return res;
-        }
+    expires_.erase(std::make_pair(stream.expires_at, stream.id));
+    ::keep_alive(stream, expires_at);
+    expires_.emplace(stream.expires_at, stream.id);
+}
+
+std::chrono::system_clock::time_point stream_registry::next_expiry() const
+{
+    if (expires_.empty())
+        return std::chrono::system_clock::time_point::max();
+    return expires_.begin()->first;
+}
+
+std::vector<stream_info> stream_registry::expired(std::chrono::system_clock::time_point now)
+{
+    std::vector<stream_info> res;
+    while (!expires_.empty() && expires_.begin()->first <= now) {
+        auto id = expires_.begin()->second;
+        res.push_back(*find(id));
+        erase(id);
     }
-    for (std::uint32_t res = min_port; res < port; res += 4) {
-        if (res && !has_port(streams, res)) {
-            port += 4;
-            if (port > max_port)
-                port = min_port;
-            return res;
-        }
+    return res;
+}
+
+const stream_info* stream_registry::slot(std::size_t slot) const
+{
+    return slot < slots_.size() && slots_[slot].id ? &slots_[slot] : nullptr;
+}
+
+std::size_t stream_registry::slots() const
+{
+    return slots_.size();
+}
+
+std::size_t stream_registry::size() const
+{
+    return ids_.size();
+}
+
+bool stream_registry::empty() const
+{
+    return ids_.empty();
+}
+
+std::size_t stream_registry::memory() const
+{
+    // Approximates a libstdc++ hash node as the value plus a next pointer and
+    // a cached hash; host strings only cost heap memory past the SSO buffer.
+    static const std::size_t node = 2 * sizeof(void*);
+    std::size_t res = 0;
+    res += slots_.capacity() * sizeof(stream_info);
+    res += free_.capacity() * sizeof(std::uint32_t);
+    res += ids_.bucket_count() * sizeof(void*) +
+        ids_.size() * (node + sizeof(std::pair<const std::uint64_t, std::uint32_t>));
+    res += hosts_.bucket_count() * sizeof(void*) +
+        hosts_.size() * (node + sizeof(std::pair<const std::string, std::uint32_t>));
+    res += ports_.bucket_count() * sizeof(void*) +
+        ports_.size() * (node + sizeof(std::pair<const std::uint16_t, std::uint32_t>));
+    res += expires_.size() * (4 * sizeof(void*) +
+        sizeof(std::pair<std::chrono::system_clock::time_point, std::uint64_t>));
+    for (auto& stream : slots_) {
+        if (stream.host.capacity() > std::string().capacity())
+            res += 2 * (stream.host.capacity() + 1);
     }
-    throw std::out_of_range("no more ports!");
+    return res;
 }
 
-stream_info make_stream(const stream_info_map& streams,
-    const std::string& host,
-    std::uint16_t min_port, std::uint16_t max_port, std::uint16_t& port,
-    bool& already_existed)
+stream_registry::iterator stream_registry::begin()
 {
-    for (auto it = streams.begin(); it != streams.end(); ++it) {
-        auto& stream = it->second;
-        if (stream.host == host) {
-            already_existed = true;
-            return stream;
-        }
+    return iterator(slots_.begin(), slots_.end());
+}
+
+stream_registry::iterator stream_registry::end()
+{
+    return iterator(slots_.end(), slots_.end());
+}
+
+stream_registry::const_iterator stream_registry::begin() const
+{
+    return const_iterator(slots_.begin(), slots_.end());
+}
+
+stream_registry::const_iterator stream_registry::end() const
+{
+    return const_iterator(slots_.end(), slots_.end());
+}
+
+stream_info make_stream(const stream_registry& streams, port_pool& ports,
+    const std::string& host, bool& already_existed)
+{
+    if (auto stream = streams.find_host(host)) {
+        already_existed = true;
+        return *stream;
     }
     stream_info stream;
-    stream.id = gen_id(streams);
+    do
+        stream.id = gen_stream_id();
+    while (streams.find(stream.id));
     stream.host = host;
-    stream.port = gen_port(streams, min_port, max_port, port);
+    stream.port = ports.allocate();
     already_existed = false;
     return stream;
 }
@@ -81,16 +206,10 @@ void keep_alive(stream_info& stream,
     stream.expires_at = expires_at;
 }
 
-stream_info_map expired(stream_info_map& streams)
+std::vector<stream_info> expired(stream_registry& streams, port_pool& ports)
 {
-    auto now = std::chrono::system_clock::now();
-    stream_info_map expires;
-    for (auto it = streams.begin(); it != streams.end(); ) {
-        auto& stream = it->second;
-        if (stream.expires_at <= now) {
-            expires[stream.id] = std::move(stream);
-            it = streams.erase(it);
-        } else ++it;
-    }
+    auto expires = streams.expired(std::chrono::system_clock::now());
+    for (auto& stream : expires)
+        ports.release(stream.port);
     return expires;
 }
@@ -1,26 +1,83 @@
 #pragma once
 
 #include "definitions.hpp"
+#include "port.hpp"
 
-#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 struct stream_info
 {
     std::uint64_t id = 0;
     std::string host;
     std::uint16_t port = 0;
+    std::uint32_t instance = 0;
     std::chrono::system_clock::time_point expires_at;
 };
 
-using stream_info_map = std::map<std::uint64_t, stream_info>;
+class stream_registry
+{
+public:
+    template <typename Value, typename Iterator>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+        basic_iterator(Iterator it, Iterator end) : it_(it), end_(end) { skip(); }
+        reference operator*() const { return *it_; }
+        pointer operator->() const { return &*it_; }
+        basic_iterator& operator++() { ++it_; skip(); return *this; }
+        basic_iterator operator++(int) { auto res = *this; ++*this; return res; }
+        bool operator==(const basic_iterator& other) const { return it_ == other.it_; }
+        bool operator!=(const basic_iterator& other) const { return it_ != other.it_; }
+    private:
+        void skip() { while (it_ != end_ && !it_->id) ++it_; }
+        Iterator it_;
+        Iterator end_;
+    };
+    using iterator = basic_iterator<stream_info, std::vector<stream_info>::iterator>;
+    using const_iterator = basic_iterator<const stream_info, std::vector<stream_info>::const_iterator>;
+    stream_info* find(std::uint64_t id);
+    const stream_info* find(std::uint64_t id) const;
+    stream_info* find_host(const std::string& host);
+    const stream_info* find_host(const std::string& host) const;
+    stream_info* find_port(std::uint16_t port);
+    const stream_info* find_port(std::uint16_t port) const;
+    stream_info& insert(const stream_info& stream);
+    bool erase(std::uint64_t id);
+    void keep_alive(stream_info& stream, std::chrono::system_clock::time_point expires_at);
+    std::chrono::system_clock::time_point next_expiry() const;
+    std::vector<stream_info> expired(std::chrono::system_clock::time_point now);
+    void reserve(std::size_t size);
+    const stream_info* slot(std::size_t slot) const;
+    std::size_t slots() const;
+    std::size_t size() const;
+    bool empty() const;
+    std::size_t memory() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+private:
+    std::vector<stream_info> slots_;
+    std::vector<std::uint32_t> free_;
+    std::unordered_map<std::uint64_t, std::uint32_t> ids_;
+    std::unordered_map<std::string, std::uint32_t> hosts_;
+    std::unordered_map<std::uint16_t, std::uint32_t> ports_;
+    std::set<std::pair<std::chrono::system_clock::time_point, std::uint64_t>> expires_;
+};
 
-stream_info make_stream(const stream_info_map& streams,
-    const std::string& host,
-    std::uint16_t min_port, std::uint16_t max_port, std::uint16_t& port,
-    bool& already_existed);
+stream_info make_stream(const stream_registry& streams, port_pool& ports,
+    const std::string& host, bool& already_existed);
 
 void keep_alive(stream_info& stream);
 void keep_alive(stream_info& stream,
     std::chrono::system_clock::time_point expires_at);
 
-stream_info_map expired(stream_info_map& streams);
+std::vector<stream_info> expired(stream_registry& streams, port_pool& ports);
@@ -0,0 +1,131 @@
+#include "unix.hpp"
+
+static const std::size_t unix_message_size = 1 << 20;
+
+unix_client::unix_client(boost::asio::io_context& ioc,
+    std::string path,
+    std::chrono::seconds timeout)
+    : socket_(ioc), deadline_(ioc), buffer_(unix_message_size), path_(std::move(path)), timeout_(timeout)
+{
+}
+
+void unix_client::operator()(std::string msg, http_client_handler handler)
+{
+    messages_.push_back({std::make_shared<std::string>(std::move(msg)), handler});
+    if (open_)
+        send();
+    else if (!connecting_)
+        connect();
+}
+
+void unix_client::on_recv(unix_handler handler)
+{
+    on_recv_ = handler;
+}
+
+void unix_client::on_close(http_client_handler handler)
+{
+    on_close_ = handler;
+}
+
+void unix_client::close()
+{
+    close(boost::asio::error::operation_aborted);
+}
+
+void unix_client::connect()
+{
+    auto self = shared_from_this();
+    auto generation = generation_;
+    std::weak_ptr<unix_client> weak = self;
+    connecting_ = true;
+    deadline_.expires_from_now(timeout_);
+    deadline_.async_wait(
+        [weak, generation](boost::system::error_code e) {
+            auto self = weak.lock();
+            if (e == boost::asio::error::operation_aborted || !self || generation != self->generation_)
+                return;
+            self->close(boost::asio::error::timed_out);
+        });
+    socket_.async_connect(boost::asio::local::stream_protocol::endpoint(path_),
+        [self, generation](boost::system::error_code e) {
+            if (generation != self->generation_)
+                return;
+            self->deadline_.cancel();
+            if (e) {
+                self->close(e);
+                return;
+            }
+            self->connecting_ = false;
+            self->open_ = true;
+            self->recv();
+            self->send();
+        });
+}
+
+void unix_client::send()
+{
+    if (!open_ || sending_ || messages_.empty())
+        return;
+    auto self = shared_from_this();
+    auto generation = generation_;
+    auto msg = messages_.front().msg;
+    sending_ = true;
+    socket_.async_send(boost::asio::buffer(*msg), 0,
+        [self, generation, msg](boost::system::error_code e, std::size_t) {
+            if (generation != self->generation_)
+                return;
+            self->sending_ = false;
+            auto handler = std::move(self->messages_.front().handler);
+            self->messages_.pop_front();
+            if (e) {
+                self->close(e);
+                handler(e);
+                return;
+            }
+            handler(e);
+            self->send();
+        });
+}
+
+void unix_client::recv()
+{
+    auto self = shared_from_this();
+    auto generation = generation_;
+    socket_.async_receive(boost::asio::buffer(buffer_), 0, flags_,
+        [self, generation](boost::system::error_code e, std::size_t size) {
+            if (generation != self->generation_)
+                return;
+            if (!e && !size)
+                e = boost::asio::error::eof;
+            if (e) {
+                self->close(e);
+                return;
+            }
+            if (self->flags_ & MSG_TRUNC)
+                BOOST_LOG_TRIVIAL(error) << "client error: message truncated";
+            else if (self->on_recv_)
+                self->on_recv_(std::string(self->buffer_.data(), size));
+            if (generation == self->generation_)
+                self->recv();
+        });
+}
+
+void unix_client::close(boost::system::error_code ec)
+{
+    if (!connecting_ && !open_)
+        return;
+    boost::system::error_code e;
+    ++generation_;
+    connecting_ = false;
+    open_ = false;
+    sending_ = false;
+    deadline_.cancel();
+    socket_.close(e);
+    std::deque<message> messages;
+    messages.swap(messages_);
+    if (on_close_)
+        on_close_(ec);
+    for (auto& m : messages)
+        m.handler(ec);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <boost/asio/generic/seq_packet_protocol.hpp>
+#include <deque>
+#include <vector>
+
+using unix_handler = std::function<void(const std::string&)>;
+
+class unix_client : public std::enable_shared_from_this<unix_client>
+{
+public:
+    unix_client(boost::asio::io_context& ioc,
+        std::string path,
+        std::chrono::seconds timeout = default_timeout);
+    unix_client(const unix_client&) = delete;
+    unix_client& operator=(const unix_client&) = delete;
+    unix_client(unix_client&&) = delete;
+    unix_client& operator=(unix_client&&) = delete;
+    void operator()(std::string msg, http_client_handler handler);
+    void on_recv(unix_handler handler);
+    void on_close(http_client_handler handler);
+    void close();
+private:
+    struct message
+    {
+        std::shared_ptr<std::string> msg;
+        http_client_handler handler;
+    };
+    void connect();
+    void send();
+    void recv();
+    void close(boost::system::error_code ec);
+    boost::asio::generic::seq_packet_protocol::socket socket_;
+    boost::asio::system_timer deadline_;
+    boost::asio::socket_base::message_flags flags_ = 0;
+    std::vector<char> buffer_;
+    std::deque<message> messages_;
+    std::string path_;
+    std::chrono::seconds timeout_;
+    unix_handler on_recv_;
+    http_client_handler on_close_;
+    std::uint64_t generation_ = 0;
+    bool connecting_ = false;
+    bool open_ = false;
+    bool sending_ = false;
+};
@@ -1,36 +1,149 @@
 #include "uri.hpp"
 
-#include <regex>
+#include <limits>
+#include <stdexcept>
 
-uri make_uri(const std::string& s)
+static int hex_to_int(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static boost::string_view next_segment(boost::string_view& s)
+{
+    while (!s.empty() && s.front() == '/')
+        s.remove_prefix(1);
+    auto pos = s.find('/');
+    auto res = s.substr(0, pos);
+    s.remove_prefix(res.size());
+    return res;
+}
+
+bool uri_query::insert(boost::string_view key, boost::string_view value)
+{
+    if (size_ == capacity || count(key))
+        return false;
+    items_[size_++] = std::make_pair(key, value);
+    return true;
+}
+
+bool uri_query::count(boost::string_view key) const
+{
+    for (std::size_t i = 0; i < size_; ++i) {
+        if (items_[i].first == key)
+            return true;
+    }
+    return false;
+}
+
+boost::string_view uri_query::raw(boost::string_view key) const
+{
+    for (std::size_t i = 0; i < size_; ++i) {
+        if (items_[i].first == key)
+            return items_[i].second;
+    }
+    throw std::out_of_range("no such query parameter");
+}
+
+std::string uri_query::at(boost::string_view key) const
+{
+    return uri_decode(raw(key));
+}
+
+std::size_t uri_query::size() const
+{
+    return size_;
+}
+
+uri make_uri(boost::string_view s)
 {
     uri res;
-    std::regex expr("(/?[^ #?]*)\\x3f?([^ #]*)\\x23?([^ ]*)");
-    auto pos = std::sregex_iterator(s.begin(), s.end(), expr);
-    auto end = std::sregex_iterator();
-    if (pos != end) {
-        const auto& match = *pos;
-        res.path = match[1];
-        res.query = match[2];
-        res.fragment = match[3];
+    auto end = s.find(' ');
+    if (end != boost::string_view::npos)
+        s = s.substr(0, end);
+    auto fragment = s.find('#');
+    if (fragment != boost::string_view::npos) {
+        res.fragment = s.substr(fragment + 1);
+        s = s.substr(0, fragment);
     }
+    auto query = s.find('?');
+    if (query != boost::string_view::npos) {
+        res.query = s.substr(query + 1);
+        s = s.substr(0, query);
+    }
+    res.path = s;
     return res;
 }
 
-uri_path make_path(const std::string& s)
+uri_query make_query(boost::string_view s)
 {
-    return boost::filesystem::path(s);
+    uri_query res;
+    while (!s.empty()) {
+        auto end = s.find('&');
+        auto item = s.substr(0, end);
+        s.remove_prefix(end == boost::string_view::npos ? s.size() : end + 1);
+        auto pos = item.find('=');
+        if (pos == boost::string_view::npos)
+            continue;
+        res.insert(item.substr(0, pos), item.substr(pos + 1));
+    }
+    return res;
 }
 
-uri_query make_query(const std::string& s)
+std::string uri_decode(boost::string_view s)
 {
-    uri_query res;
-    std::regex expr("([^=]*)=([^&]*)&?");
-    auto pos = std::sregex_iterator(s.begin(), s.end(), expr);
-    auto end = std::sregex_iterator();
-    for ( ; pos != end; ++pos) {
-        const auto& match = *pos;
-        res.insert(std::make_pair(match[1], match[2]));
+    if (s.find_first_of("%+") == boost::string_view::npos)
+        return std::string(s.data(), s.size());
+    std::string res;
+    res.reserve(s.size());
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        int hi, lo;
+        if (s[i] == '+')
+            res.push_back(' ');
+        else if (s[i] == '%' && i + 2 < s.size() &&
+            (hi = hex_to_int(s[i + 1])) >= 0 && (lo = hex_to_int(s[i + 2])) >= 0) {
+            res.push_back(static_cast<char>(hi << 4 | lo));
+            i += 2;
+        } else
+            res.push_back(s[i]);
     }
     return res;
 }
+
+bool uri_match(boost::string_view pattern, boost::string_view path, boost::string_view& param)
+{
+    if (path.empty() || path.front() != '/')
+        return false;
+    for (;;) {
+        auto expected = next_segment(pattern);
+        auto segment = next_segment(path);
+        if (expected.empty() || segment.empty())
+            return expected.empty() && segment.empty();
+        if (expected == "{}")
+            param = segment;
+        else if (expected != segment)
+            return false;
+    }
+}
+
+bool uri_to_uint(boost::string_view s, std::uint64_t& res)
+{
+    if (s.empty() || s.size() > 20)
+        return false;
+    std::uint64_t value = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9')
+            return false;
+        std::uint64_t digit = c - '0';
+        if (value > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+            return false;
+        value = value * 10 + digit;
+    }
+    res = value;
+    return true;
+}
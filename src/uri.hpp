@@ -1,18 +1,32 @@
 #pragma once
 
-#include <boost/filesystem.hpp>
-#include <map>
+#include <array>
+#include <boost/utility/string_view.hpp>
+#include <string>
 
 struct uri
 {
-    std::string path;
-    std::string query;
-    std::string fragment;
+    boost::string_view path;
+    boost::string_view query;
+    boost::string_view fragment;
 };
 
-using uri_path = boost::filesystem::path;
-using uri_query = std::map<std::string, std::string>;
+class uri_query
+{
+public:
+    static const std::size_t capacity = 16;
+    bool insert(boost::string_view key, boost::string_view value);
+    bool count(boost::string_view key) const;
+    boost::string_view raw(boost::string_view key) const;
+    std::string at(boost::string_view key) const;
+    std::size_t size() const;
+private:
+    std::array<std::pair<boost::string_view, boost::string_view>, capacity> items_;
+    std::size_t size_ = 0;
+};
 
-uri make_uri(const std::string& s);
-uri_path make_path(const std::string& s);
-uri_query make_query(const std::string& s);
+uri make_uri(boost::string_view s);
+uri_query make_query(boost::string_view s);
+std::string uri_decode(boost::string_view s);
+bool uri_match(boost::string_view pattern, boost::string_view path, boost::string_view& param);
+bool uri_to_uint(boost::string_view s, std::uint64_t& res);
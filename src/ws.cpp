@@ -0,0 +1,146 @@
+#include "ws.hpp"
+
+ws_client::ws_client(boost::asio::io_context& ioc,
+    boost::asio::ip::tcp::endpoint ep,
+    std::string target, std::string protocol,
+    std::chrono::seconds timeout)
+    : ioc_(ioc), ep_(ep), target_(std::move(target)), protocol_(std::move(protocol)), timeout_(timeout)
+{
+}
+
+void ws_client::operator()(std::string msg, http_client_handler handler)
+{
+    messages_.push_back({std::make_shared<std::string>(std::move(msg)), handler});
+    if (open_)
+        send();
+    else if (!connecting_)
+        connect();
+}
+
+void ws_client::on_recv(ws_handler handler)
+{
+    on_recv_ = handler;
+}
+
+void ws_client::on_close(http_client_handler handler)
+{
+    on_close_ = handler;
+}
+
+void ws_client::close()
+{
+    close(boost::asio::error::operation_aborted);
+}
+
+void ws_client::connect()
+{
+    auto self = shared_from_this();
+    auto generation = generation_;
+    connecting_ = true;
+    stream_ = std::make_unique<stream>(ioc_);
+    stream_->next_layer().expires_after(timeout_);
+    stream_->next_layer().async_connect(ep_,
+        [self, generation](boost::system::error_code e) {
+            if (generation != self->generation_)
+                return;
+            if (e) {
+                self->close(e);
+                return;
+            }
+            self->handshake();
+        });
+}
+
+void ws_client::handshake()
+{
+    auto self = shared_from_this();
+    auto generation = generation_;
+    auto protocol = protocol_;
+    stream_->next_layer().expires_never();
+    stream_->set_option(boost::beast::websocket::stream_base::timeout{
+        timeout_, boost::beast::websocket::stream_base::none(), false});
+    stream_->set_option(boost::beast::websocket::stream_base::decorator(
+        [protocol](boost::beast::websocket::request_type& req) {
+            req.set(boost::beast::http::field::sec_websocket_protocol, protocol);
+        }));
+    stream_->text(true);
+    stream_->async_handshake(ep_.address().to_string() + ":" + std::to_string(ep_.port()), target_,
+        [self, generation](boost::system::error_code e) {
+            if (generation != self->generation_)
+                return;
+            if (e) {
+                self->close(e);
+                return;
+            }
+            self->connecting_ = false;
+            self->open_ = true;
+            self->recv();
+            self->send();
+        });
+}
+
+void ws_client::send()
+{
+    if (!open_ || sending_ || messages_.empty())
+        return;
+    auto self = shared_from_this();
+    auto generation = generation_;
+    auto msg = messages_.front().msg;
+    sending_ = true;
+    stream_->async_write(boost::asio::buffer(*msg),
+        [self, generation, msg](boost::system::error_code e, std::size_t) {
+            if (generation != self->generation_)
+                return;
+            self->sending_ = false;
+            auto handler = std::move(self->messages_.front().handler);
+            self->messages_.pop_front();
+            if (e) {
+                self->close(e);
+                handler(e);
+                return;
+            }
+            handler(e);
+            self->send();
+        });
+}
+
+void ws_client::recv()
+{
+    auto self = shared_from_this();
+    auto generation = generation_;
+    stream_->async_read(buffer_,
+        [self, generation](boost::system::error_code e, std::size_t) {
+            if (generation != self->generation_)
+                return;
+            if (e) {
+                self->close(e);
+                return;
+            }
+            auto msg = boost::beast::buffers_to_string(self->buffer_.data());
+            self->buffer_.consume(self->buffer_.size());
+            if (self->on_recv_)
+                self->on_recv_(msg);
+            if (generation == self->generation_)
+                self->recv();
+        });
+}
+
+void ws_client::close(boost::system::error_code ec)
+{
+    if (!stream_)
+        return;
+    boost::system::error_code e;
+    ++generation_;
+    connecting_ = false;
+    open_ = false;
+    sending_ = false;
+    stream_->next_layer().socket().close(e);
+    stream_.reset();
+    buffer_.consume(buffer_.size());
+    std::deque<message> messages;
+    messages.swap(messages_);
+    if (on_close_)
+        on_close_(ec);
+    for (auto& m : messages)
+        m.handler(ec);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <boost/beast/websocket.hpp>
+#include <deque>
+
+using ws_handler = std::function<void(const std::string&)>;
+
+class ws_client : public std::enable_shared_from_this<ws_client>
+{
+public:
+    ws_client(boost::asio::io_context& ioc,
+        boost::asio::ip::tcp::endpoint ep,
+        std::string target, std::string protocol,
+        std::chrono::seconds timeout = default_timeout);
+    ws_client(const ws_client&) = delete;
+    ws_client& operator=(const ws_client&) = delete;
+    ws_client(ws_client&&) = delete;
+    ws_client& operator=(ws_client&&) = delete;
+    void operator()(std::string msg, http_client_handler handler);
+    void on_recv(ws_handler handler);
+    void on_close(http_client_handler handler);
+    void close();
+private:
+    using stream = boost::beast::websocket::stream<boost::beast::tcp_stream>;
+    struct message
+    {
+        std::shared_ptr<std::string> msg;
+        http_client_handler handler;
+    };
+    void connect();
+    void handshake();
+    void send();
+    void recv();
+    void close(boost::system::error_code ec);
+    boost::asio::io_context& ioc_;
+    std::unique_ptr<stream> stream_;
+    boost::beast::flat_buffer buffer_;
+    std::deque<message> messages_;
+    boost::asio::ip::tcp::endpoint ep_;
+    std::string target_;
+    std::string protocol_;
+    std::chrono::seconds timeout_;
+    ws_handler on_recv_;
+    http_client_handler on_close_;
+    std::uint64_t generation_ = 0;
+    bool connecting_ = false;
+    bool open_ = false;
+    bool sending_ = false;
+};
@@ -0,0 +1,171 @@
+#include "hash.hpp"
+// The handlers are file-local to main.cpp, so the tests compile it in with
+// JANUS_MANAGER_NO_MAIN, the same way janus-bench does.
+#include "main.cpp"
+
+#include <gtest/gtest.h>
+
+// Holds every request until answer() is called, then replies the way Janus
+// would, so a test can act while calls are in flight.
+class held_transport : public janus_transport
+{
+public:
+    explicit held_transport(std::size_t capacity = 16) : capacity_(capacity) {}
+    void operator()(std::uint64_t session_id, std::uint64_t session_plugin_id,
+        nlohmann::json req_json, janus_json_handler handler) override
+    { held_.emplace_back(std::move(req_json), std::move(handler)); }
+    std::size_t capacity() const override { return capacity_; }
+    void close() override {}
+    std::size_t held() const { return held_.size(); }
+    void answer(bool ok = true)
+    {
+        while (!held_.empty()) {
+            auto call = std::move(held_.front());
+            held_.pop_front();
+            call.second(ok, ok ? reply(call.first) : nlohmann::json());
+        }
+    }
+private:
+    static nlohmann::json reply(const nlohmann::json& req_json)
+    {
+        nlohmann::json res_json;
+        res_json["janus"] = "success";
+        auto janus = req_json.value("janus", "");
+        if (janus == "ping")
+            res_json["janus"] = "pong";
+        else if (janus == "create")
+            res_json["data"]["id"] = 1;
+        else if (janus == "attach")
+            res_json["data"]["id"] = 2;
+        else if (req_json.at("body").value("request", "") == "create")
+            res_json["plugindata"]["data"]["created"] = "created";
+        else if (req_json.at("body").value("request", "") == "list")
+            res_json["plugindata"]["data"]["list"] = nlohmann::json::array();
+        return res_json;
+    }
+    std::size_t capacity_;
+    std::deque<std::pair<nlohmann::json, janus_json_handler>> held_;
+};
+
+static std::shared_ptr<held_transport> transport;
+
+static void setup()
+{
+    instances.clear();
+    instances.push_back(std::make_unique<janus_instance>());
+    auto& instance = *instances[0];
+    instance.ports = std::make_unique<port_pool>(20000, 20063, 20000);
+    transport = std::make_shared<held_transport>();
+    instance.janus = std::make_shared<janus_client>(ioc, transport);
+    instance.state = janus_ready;
+    streams = stream_registry();
+    inflight.clear();
+    creating.clear();
+}
+
+static stream_info add_stream(const std::string& host, std::chrono::system_clock::time_point expires_at)
+{
+    bool already_existed = false;
+    auto stream = make_stream(streams, *instances[0]->ports, host, already_existed);
+    keep_alive(stream, expires_at);
+    return streams.insert(stream);
+}
+
+static void poll()
+{
+    ioc.restart();
+    ioc.run_for(std::chrono::milliseconds(20));
+}
+
+// Every registered stream must hold its port, or the port is handed out twice.
+static void expect_consistent()
+{
+    auto& ports = *instances[0]->ports;
+    EXPECT_EQ(ports.used(), streams.size());
+    for (auto& stream : streams)
+        EXPECT_TRUE(ports.has(stream.port)) << "stream " << stream.id;
+}
+
+struct request
+{
+    http_req req;
+    http_res res;
+    bool done = false;
+};
+
+static std::unique_ptr<request> post(const std::string& target, const std::string& body = "")
+{
+    auto r = std::make_unique<request>();
+    r->req = http_req(boost::beast::http::verb::post, target, 11);
+    r->req.body() = body;
+    auto done = &r->done;
+    handle_safe(r->req, r->res, [done]() { *done = true; });
+    return r;
+}
+
+TEST(batch_post, reaped_stream_stays_reaped)
+{
+    setup();
+    auto existing = add_stream("a", std::chrono::system_clock::now() - std::chrono::seconds(1));
+    auto r = post("/streams/batch", R"({"streams":[{"host":"a","expires_at":"min"},{"host":"b"}]})");
+    EXPECT_FALSE(r->done);
+    start_expiry();
+    poll();
+    EXPECT_FALSE(streams.find(existing.id));
+    transport->answer();
+    ASSERT_TRUE(r->done);
+    EXPECT_EQ(r->res.result(), boost::beast::http::status::ok);
+    EXPECT_FALSE(streams.find(existing.id));
+    EXPECT_TRUE(streams.find_host("b"));
+    expect_consistent();
+}
+
+TEST(batch_post, existing_stream_is_kept_alive_before_creates)
+{
+    setup();
+    auto existing = add_stream("a", std::chrono::system_clock::now() - std::chrono::seconds(1));
+    auto r = post("/streams/batch", R"({"streams":[{"host":"a"},{"host":"b"}]})");
+    start_expiry();
+    poll();
+    ASSERT_TRUE(streams.find(existing.id));
+    transport->answer();
+    poll();
+    ASSERT_TRUE(r->done);
+    EXPECT_TRUE(streams.find(existing.id));
+    EXPECT_TRUE(streams.find_host("b"));
+    expect_consistent();
+}
+
+TEST(batch_post, warm_stream_is_visible_before_creates)
+{
+    setup();
+    stream_info warm;
+    warm.id = gen_stream_id();
+    warm.port = instances[0]->ports->allocate();
+    instances[0]->warm.push_back(warm);
+    auto r = post("/streams/batch", R"({"streams":[{"host":"x"},{"host":"y"}]})");
+    EXPECT_FALSE(r->done);
+    auto held = transport->held();
+    auto single = post("/streams?host=x");
+    ASSERT_TRUE(single->done);
+    EXPECT_EQ(nlohmann::json::parse(single->res.body()).at("stream").at("id"), warm.id);
+    EXPECT_EQ(transport->held(), held);
+    transport->answer();
+    ASSERT_TRUE(r->done);
+    EXPECT_EQ(streams.size(), 2u);
+    expect_consistent();
+}
+
+TEST(janus_client, ping_waits_for_capacity)
+{
+    auto transport = std::make_shared<held_transport>(1);
+    auto client = std::make_shared<janus_client>(ioc, transport);
+    bool listed = false;
+    bool pong = false;
+    client->stream_list([&listed](bool ok, const std::vector<stream_info>&) { listed = ok; });
+    client->ping([&pong](bool ok) { pong = ok; });
+    EXPECT_EQ(transport->held(), 1u);
+    transport->answer();
+    EXPECT_TRUE(listed);
+    EXPECT_TRUE(pong);
+}
@@ -0,0 +1,69 @@
+#include "port.hpp"
+
+#include <gtest/gtest.h>
+#include <set>
+#include <stdexcept>
+
+TEST(port_pool, allocate_until_exhausted)
+{
+    port_pool ports(20000, 20015, 20008);
+    EXPECT_EQ(ports.size(), 4u);
+    EXPECT_EQ(ports.allocate(), 20008);
+    EXPECT_EQ(ports.allocate(), 20012);
+    EXPECT_EQ(ports.allocate(), 20000);
+    EXPECT_EQ(ports.allocate(), 20004);
+    EXPECT_EQ(ports.used(), 4u);
+    EXPECT_DOUBLE_EQ(ports.occupancy(), 1.0);
+    EXPECT_THROW(ports.allocate(), std::out_of_range);
+    EXPECT_EQ(ports.used(), 4u);
+}
+
+TEST(port_pool, release_and_reuse)
+{
+    port_pool ports(20000, 20015, 20000);
+    for (int i = 0; i < 4; ++i)
+        ports.allocate();
+    ports.release(20004);
+    EXPECT_FALSE(ports.has(20004));
+    EXPECT_EQ(ports.used(), 3u);
+    EXPECT_EQ(ports.allocate(), 20004);
+    EXPECT_TRUE(ports.has(20004));
+    EXPECT_THROW(ports.allocate(), std::out_of_range);
+}
+
+TEST(port_pool, released_block_is_reused_last)
+{
+    port_pool ports(20000, 20015, 20000);
+    auto port = ports.allocate();
+    ports.release(port);
+    std::set<std::uint16_t> allocated;
+    for (int i = 0; i < 3; ++i)
+        allocated.insert(ports.allocate());
+    EXPECT_EQ(allocated.count(port), 0u);
+    EXPECT_EQ(ports.allocate(), port);
+}
+
+TEST(port_pool, release_out_of_range)
+{
+    port_pool ports(20000, 20015, 20000);
+    ports.allocate();
+    ports.release(19996);
+    ports.release(20016);
+    ports.release(20001);
+    ports.release(20004);
+    EXPECT_EQ(ports.used(), 1u);
+    EXPECT_TRUE(ports.has(20000));
+    EXPECT_FALSE(ports.reserve(20016));
+    EXPECT_FALSE(ports.reserve(20002));
+    EXPECT_FALSE(ports.reserve(20000));
+    EXPECT_TRUE(ports.reserve(20004));
+    EXPECT_EQ(ports.used(), 2u);
+}
+
+TEST(port_pool, invalid_range)
+{
+    EXPECT_THROW(port_pool(0, 15, 0), std::out_of_range);
+    EXPECT_THROW(port_pool(20000, 20014, 20000), std::out_of_range);
+    EXPECT_THROW(port_pool(20000, 20015, 20002), std::out_of_range);
+    EXPECT_THROW(port_pool(20000, 20015, 20016), std::out_of_range);
+}
@@ -0,0 +1,164 @@
+#include "janus.hpp"
+
+#include <boost/process.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
+
+// Runs the WebSocket transport end to end against janus-mock, which the build
+// passes in as JANUS_MOCK.
+
+static const std::uint16_t mock_port = 18088;
+static const std::uint16_t mock_admin_port = 18089;
+static const std::uint16_t mock_ws_port = 18188;
+static const std::string mock_admin_key = "streamingkey";
+
+class ws_transport : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        start_mock();
+        client_ = make_client(mock_admin_key);
+        client_->start();
+        ASSERT_TRUE(wait_ready());
+    }
+
+    void TearDown() override
+    {
+        client_->cancel();
+        ioc_.restart();
+        ioc_.poll();
+        mock_.terminate();
+    }
+
+    void start_mock()
+    {
+        mock_ = boost::process::child(JANUS_MOCK,
+            "-q", std::to_string(mock_port),
+            "-a", std::to_string(mock_admin_port),
+            "-o", std::to_string(mock_ws_port),
+            "-k", mock_admin_key,
+            boost::process::std_out > boost::process::null,
+            boost::process::std_err > boost::process::null);
+    }
+
+    std::shared_ptr<janus_client> make_client(const std::string& admin_key)
+    {
+        return std::make_shared<janus_client>(ioc_, make_janus_ws_transport(ioc_,
+            boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), mock_ws_port)),
+            admin_key);
+    }
+
+    template <typename Call>
+    void run(Call call)
+    {
+        bool done = false;
+        call(done);
+        ioc_.restart();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!done && std::chrono::steady_clock::now() < deadline)
+            ioc_.run_one_for(std::chrono::milliseconds(100));
+        ASSERT_TRUE(done);
+    }
+
+    bool ping()
+    {
+        bool res = false;
+        run([this, &res](bool& done) {
+            client_->ping([&res, &done](bool ok) { res = ok; done = true; });
+        });
+        return res;
+    }
+
+    bool wait_ready()
+    {
+        for (int i = 0; i < 100; ++i) {
+            if (ping())
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    bool create(const stream_info& stream)
+    {
+        bool res = false;
+        run([this, &stream, &res](bool& done) {
+            client_->stream_create(stream, [&res, &done](bool ok) { res = ok; done = true; });
+        });
+        return res;
+    }
+
+    bool remove(const stream_info& stream)
+    {
+        bool res = false;
+        run([this, &stream, &res](bool& done) {
+            client_->stream_remove(stream, [&res, &done](bool ok) { res = ok; done = true; });
+        });
+        return res;
+    }
+
+    std::vector<stream_info> list()
+    {
+        return list(*client_);
+    }
+
+    std::vector<stream_info> list(janus_client& client)
+    {
+        std::vector<stream_info> res;
+        run([&client, &res](bool& done) {
+            client.stream_list([&res, &done](bool ok, const std::vector<stream_info>& streams) {
+                EXPECT_TRUE(ok);
+                res = streams;
+                done = true;
+            });
+        });
+        return res;
+    }
+
+    static stream_info make(std::uint64_t id, std::uint16_t port)
+    {
+        stream_info stream;
+        stream.id = id;
+        stream.host = "ws-" + std::to_string(id);
+        stream.port = port;
+        return stream;
+    }
+
+    static bool listed(const std::vector<stream_info>& streams, const stream_info& stream)
+    {
+        return std::any_of(streams.begin(), streams.end(),
+            [&stream](const stream_info& s) { return s.id == stream.id && s.port == stream.port; });
+    }
+
+    boost::asio::io_context ioc_;
+    boost::process::child mock_;
+    std::shared_ptr<janus_client> client_;
+};
+
+TEST_F(ws_transport, create_list_destroy)
+{
+    auto stream = make(0x80000001, 20000);
+    ASSERT_TRUE(create(stream));
+    EXPECT_FALSE(create(stream));
+    EXPECT_TRUE(listed(list(), stream));
+    EXPECT_FALSE(listed(list(*make_client("")), stream));
+    ASSERT_TRUE(remove(stream));
+    EXPECT_FALSE(listed(list(), stream));
+}
+
+TEST_F(ws_transport, reconnect_after_server_drops)
+{
+    auto stream = make(0x80000002, 20004);
+    ASSERT_TRUE(create(stream));
+    mock_.terminate();
+    ioc_.restart();
+    ioc_.run_for(std::chrono::milliseconds(100));
+    start_mock();
+    ASSERT_TRUE(wait_ready());
+    EXPECT_FALSE(listed(list(), stream));
+    ASSERT_TRUE(create(stream));
+    EXPECT_TRUE(listed(list(), stream));
+    ASSERT_TRUE(remove(stream));
+}
@@ -0,0 +1,276 @@
+#include "hash.hpp"
+// The request handlers and response writers are file-local to main.cpp, so the
+// benchmark compiles it in with JANUS_MANAGER_NO_MAIN and drives them directly.
+#include "main.cpp"
+
+#include <benchmark/benchmark.h>
+#include <map>
+#include <regex>
+
+static const std::uint16_t bench_port_min = 1024;
+
+static port_pool& bench_ports()
+{ return *instances[0]->ports; }
+
+static void fill_registry(std::size_t size, std::size_t occupancy,
+    std::chrono::system_clock::time_point expires_at = std::chrono::system_clock::now() + timeout_keepalive)
+{
+    auto blocks = std::max<std::size_t>(size * 100 / std::max<std::size_t>(occupancy, 1), 1);
+    instances.clear();
+    instances.push_back(std::make_unique<janus_instance>());
+    instances[0]->ports = std::make_unique<port_pool>(bench_port_min, bench_port_min + blocks * 4 - 1, bench_port_min);
+    streams = stream_registry();
+    streams.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        bool already_existed = false;
+        auto stream = make_stream(streams, bench_ports(), "bench-" + std::to_string(i), already_existed);
+        keep_alive(stream, expires_at);
+        streams.insert(stream);
+    }
+}
+
+static std::uint64_t random_id(std::mt19937_64& random_engine)
+{
+    for (;;) {
+        auto stream = streams.slot(std::uniform_int_distribution<std::size_t>(0, streams.slots() - 1)(random_engine));
+        if (stream)
+            return stream->id;
+    }
+}
+
+static void registry_args(benchmark::internal::Benchmark* b)
+{
+    for (std::int64_t size : {256, 1024, 4096, 8000})
+        for (std::int64_t occupancy : {50, 90, 100})
+            b->Args({size, occupancy});
+}
+
+static void BM_make_stream(benchmark::State& state)
+{
+    fill_registry(state.range(0), state.range(1));
+    auto blocks = bench_ports().size();
+    if (bench_ports().used() == blocks)
+        bench_ports().release(streams.slot(0)->port);
+    for (auto _ : state) {
+        bool already_existed = false;
+        auto stream = make_stream(streams, bench_ports(), "bench-new", already_existed);
+        benchmark::DoNotOptimize(stream);
+        bench_ports().release(stream.port);
+    }
+}
+BENCHMARK(BM_make_stream)->Apply(registry_args);
+
+static void BM_make_stream_existing(benchmark::State& state)
+{
+    fill_registry(state.range(0), state.range(1));
+    std::mt19937_64 random_engine(1);
+    std::vector<std::string> hosts;
+    for (std::size_t i = 0; i < 1024; ++i)
+        hosts.push_back("bench-" + std::to_string(random_engine() % state.range(0)));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        bool already_existed = false;
+        auto stream = make_stream(streams, bench_ports(), hosts[i++ % hosts.size()], already_existed);
+        benchmark::DoNotOptimize(stream);
+    }
+}
+BENCHMARK(BM_make_stream_existing)->Apply(registry_args);
+
+// The pool spans the whole port range (16128 blocks) regardless of the registry
+// size, so the occupancy is the only variable.
+static void BM_port_pool(benchmark::State& state)
+{
+    port_pool ports(bench_port_min, 65535, bench_port_min);
+    auto used = ports.size() * state.range(0) / 100;
+    for (std::size_t i = 0; i < used; ++i)
+        ports.allocate();
+    if (ports.used() == ports.size())
+        ports.release(bench_port_min);
+    for (auto _ : state) {
+        auto port = ports.allocate();
+        benchmark::DoNotOptimize(port);
+        ports.release(port);
+    }
+}
+BENCHMARK(BM_port_pool)->Arg(0)->Arg(50)->Arg(90)->Arg(100);
+
+static void BM_gen_stream_id(benchmark::State& state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(gen_stream_id());
+}
+BENCHMARK(BM_gen_stream_id);
+
+static void BM_gen_uid(benchmark::State& state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(gen_uid());
+}
+BENCHMARK(BM_gen_uid);
+
+static void BM_expired_none(benchmark::State& state)
+{
+    fill_registry(state.range(0), state.range(1));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(expired(streams, bench_ports()));
+}
+BENCHMARK(BM_expired_none)->Apply(registry_args);
+
+static void BM_expired_all(benchmark::State& state)
+{
+    for (auto _ : state) {
+        state.PauseTiming();
+        fill_registry(state.range(0), state.range(1), std::chrono::system_clock::now() - std::chrono::seconds(1));
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(expired(streams, bench_ports()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_expired_all)->Apply(registry_args);
+
+static const std::string bench_target = "/streams/2147483911?expires_at=1792263427563&host=192.168.1.100#top";
+
+static void BM_make_uri(benchmark::State& state)
+{
+    for (auto _ : state) {
+        auto uri = make_uri(bench_target);
+        auto query = make_query(uri.query);
+        benchmark::DoNotOptimize(query.at("host"));
+    }
+}
+BENCHMARK(BM_make_uri);
+
+static void BM_make_uri_regex(benchmark::State& state)
+{
+    for (auto _ : state) {
+        std::regex uri_expr("(/?[^ #?]*)\\x3f?([^ #]*)\\x23?([^ ]*)");
+        std::string query;
+        auto pos = std::sregex_iterator(bench_target.begin(), bench_target.end(), uri_expr);
+        if (pos != std::sregex_iterator())
+            query = (*pos)[2];
+        std::regex query_expr("([^=]*)=([^&]*)&?");
+        std::map<std::string, std::string> res;
+        for (pos = std::sregex_iterator(query.begin(), query.end(), query_expr); pos != std::sregex_iterator(); ++pos)
+            res.insert(std::make_pair((*pos)[1], (*pos)[2]));
+        benchmark::DoNotOptimize(res.at("host"));
+    }
+}
+BENCHMARK(BM_make_uri_regex);
+
+static void BM_stream_to_json(benchmark::State& state)
+{
+    fill_registry(1, 100);
+    auto stream = *streams.slot(0);
+    std::string res;
+    for (auto _ : state) {
+        res.clear();
+        stream_to_json(stream, res);
+        benchmark::DoNotOptimize(res.data());
+    }
+}
+BENCHMARK(BM_stream_to_json);
+
+static void bench_handle(benchmark::State& state, boost::beast::http::verb method, bool existing)
+{
+    fill_registry(state.range(0), state.range(1));
+    std::mt19937_64 random_engine(1);
+    std::vector<std::string> targets;
+    for (std::size_t i = 0; i < 1024; ++i)
+        targets.push_back("/streams/" + std::to_string(existing ? random_id(random_engine) : i + 1));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        http_req req(method, targets[i++ % targets.size()], 11);
+        http_res res;
+        std::size_t route = 0;
+        handle(req, res, []() {}, route);
+        benchmark::DoNotOptimize(res.body().data());
+    }
+}
+
+static void BM_handle_get(benchmark::State& state)
+{ bench_handle(state, boost::beast::http::verb::get, true); }
+BENCHMARK(BM_handle_get)->Apply(registry_args);
+
+static void BM_handle_put(benchmark::State& state)
+{ bench_handle(state, boost::beast::http::verb::put, true); }
+BENCHMARK(BM_handle_put)->Apply(registry_args);
+
+static void BM_handle_not_found(benchmark::State& state)
+{ bench_handle(state, boost::beast::http::verb::get, false); }
+BENCHMARK(BM_handle_not_found)->Apply(registry_args);
+
+static void BM_handle_streams_get(benchmark::State& state)
+{
+    fill_registry(state.range(0), state.range(1));
+    for (auto _ : state) {
+        http_req req(boost::beast::http::verb::get, "/streams", 11);
+        http_res res;
+        std::size_t route = 0;
+        handle(req, res, []() {}, route);
+        benchmark::DoNotOptimize(res.body().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_handle_streams_get)->Apply(registry_args);
+
+static void BM_handle_safe_get(benchmark::State& state)
+{
+    fill_registry(state.range(0), state.range(1));
+    std::mt19937_64 random_engine(1);
+    auto target = "/streams/" + std::to_string(random_id(random_engine));
+    for (auto _ : state) {
+        http_req req(boost::beast::http::verb::get, target, 11);
+        http_res res;
+        handle_safe(req, res, []() {});
+        benchmark::DoNotOptimize(res.body().data());
+    }
+}
+BENCHMARK(BM_handle_safe_get)->Args({1024, 100});
+
+static void BM_journal_load(benchmark::State& state)
+{
+    auto dir = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    stream_registry registry;
+    registry.reserve(state.range(0));
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        stream_info stream;
+        stream.id = 0x80000000 | i;
+        stream.host = "192.168." + std::to_string(i / 256 % 256) + "." + std::to_string(i % 256);
+        stream.port = 20000 + (i % 10000) * 4;
+        keep_alive(stream);
+        registry.insert(stream);
+    }
+    {
+        stream_journal j(ioc, dir, registry);
+        j.load(registry);
+        j.compact();
+    }
+    for (auto _ : state) {
+        stream_registry loaded;
+        stream_journal j(ioc, dir, loaded);
+        benchmark::DoNotOptimize(j.load(loaded));
+    }
+    boost::filesystem::remove_all(dir);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_journal_load)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_metric_histogram(benchmark::State& state)
+{
+    metric_histogram histogram;
+    std::int64_t i = 0;
+    for (auto _ : state)
+        histogram.observe(std::chrono::microseconds(i++ & 0xffff));
+    benchmark::DoNotOptimize(histogram.count());
+}
+BENCHMARK(BM_metric_histogram);
+
+int main(int argc, char* argv[])
+{
+    boost::log::core::get()->set_logging_enabled(false);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
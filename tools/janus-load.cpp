@@ -0,0 +1,189 @@
+#include "http.hpp"
+
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <unistd.h>
+
+enum load_op { load_post, load_get, load_put, load_ops };
+
+static const char* load_op_names[] = {"post", "get", "put"};
+
+static std::string host = "127.0.0.1";
+static std::uint16_t port = 8087;
+static std::size_t concurrency = 16;
+static std::size_t rate = 0;
+static std::size_t hosts = 200;
+static std::chrono::seconds duration(10);
+static std::array<std::size_t, load_ops> mix = {{1, 8, 1}};
+
+struct load_stats
+{
+    std::vector<std::chrono::microseconds> latencies;
+    std::uint64_t errors = 0;
+};
+
+struct load_worker
+{
+    load_worker(boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint ep)
+        : client(std::make_shared<http_client>(ioc, ep)), timer(ioc)
+    {
+    }
+    std::shared_ptr<http_client> client;
+    boost::asio::system_timer timer;
+    http_req req;
+    http_res res;
+};
+
+static boost::asio::io_context ioc;
+static std::mt19937_64 random_engine(std::random_device{}());
+static std::array<load_stats, load_ops> stats;
+static std::vector<std::uint64_t> ids;
+static std::chrono::system_clock::time_point started_at;
+static std::chrono::system_clock::time_point stopped_at;
+static std::uint64_t scheduled = 0;
+
+static load_op next_op()
+{
+    auto total = mix[load_post] + mix[load_get] + mix[load_put];
+    auto n = std::uniform_int_distribution<std::size_t>(0, std::max<std::size_t>(total, 1) - 1)(random_engine);
+    auto op = n < mix[load_post] ? load_post : n < mix[load_post] + mix[load_get] ? load_get : load_put;
+    return ids.empty() ? load_post : op;
+}
+
+static std::string make_target(load_op op)
+{
+    if (op == load_post)
+        return "/streams?host=load-" +
+            std::to_string(std::uniform_int_distribution<std::size_t>(0, hosts - 1)(random_engine));
+    auto id = ids[std::uniform_int_distribution<std::size_t>(0, ids.size() - 1)(random_engine)];
+    return "/streams/" + std::to_string(id);
+}
+
+static void run(const std::shared_ptr<load_worker>& w);
+
+static void send(const std::shared_ptr<load_worker>& w, std::chrono::system_clock::time_point at)
+{
+    static const boost::beast::http::verb verbs[] = {
+        boost::beast::http::verb::post, boost::beast::http::verb::get, boost::beast::http::verb::put};
+    auto op = next_op();
+    w->req = http_req(verbs[op], make_target(op), 11);
+    w->req.set(boost::beast::http::field::host, host);
+    w->req.keep_alive(true);
+    w->req.prepare_payload();
+    w->res = {};
+    (*w->client)(w->req, w->res,
+        [w, op, at](boost::system::error_code ec) {
+            auto& s = stats[op];
+            s.latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now() - at));
+            if (ec || w->res.result() != boost::beast::http::status::ok) {
+                ++s.errors;
+            } else if (op == load_post) {
+                try {
+                    ids.push_back(nlohmann::json::parse(w->res.body()).at("stream").at("id"));
+                } catch (const std::exception&) {
+                    ++s.errors;
+                }
+            }
+            run(w);
+        });
+}
+
+static void run(const std::shared_ptr<load_worker>& w)
+{
+    auto now = std::chrono::system_clock::now();
+    if (now >= stopped_at)
+        return;
+    if (!rate) {
+        send(w, now);
+        return;
+    }
+    auto at = started_at + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(scheduled++) / rate));
+    if (at >= stopped_at)
+        return;
+    if (at <= now) {
+        send(w, at);
+        return;
+    }
+    w->timer.expires_at(at);
+    w->timer.async_wait(
+        [w, at](boost::system::error_code ec) {
+            if (!ec)
+                send(w, at);
+        });
+}
+
+static std::chrono::microseconds percentile(const std::vector<std::chrono::microseconds>& v, double p)
+{ return v.empty() ? std::chrono::microseconds(0) : v[std::min(v.size() - 1, static_cast<std::size_t>(p * v.size()))]; }
+
+static void report(const char* name, std::vector<std::chrono::microseconds> v, std::uint64_t errors,
+    double elapsed)
+{
+    std::sort(v.begin(), v.end());
+    std::printf("%-6s requests=%zu errors=%llu rate=%.1f/s p50=%lldus p99=%lldus p999=%lldus max=%lldus\n",
+        name, v.size(), static_cast<unsigned long long>(errors), elapsed > 0 ? v.size() / elapsed : 0,
+        static_cast<long long>(percentile(v, 0.5).count()),
+        static_cast<long long>(percentile(v, 0.99).count()),
+        static_cast<long long>(percentile(v, 0.999).count()),
+        static_cast<long long>(v.empty() ? 0 : v.back().count()));
+}
+
+static void usage(char* argv[])
+{
+    std::printf("Usage: %s [OPTIONS]", argv[0]);
+    std::printf("\n  -h help");
+    std::printf("\n  -l arg (%s) server host", host.c_str());
+    std::printf("\n  -p arg (%u) server port", port);
+    std::printf("\n  -c arg (%zu) concurrency", concurrency);
+    std::printf("\n  -r arg (%zu) rate, requests per second, 0 for closed loop", rate);
+    std::printf("\n  -d arg (%lld) duration, s", static_cast<long long>(duration.count()));
+    std::printf("\n  -n arg (%zu) number of distinct hosts", hosts);
+    std::printf("\n  -m arg (%zu:%zu:%zu) post:get:put mix", mix[load_post], mix[load_get], mix[load_put]);
+    std::printf("\n");
+    std::printf("\n");
+    std::exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+    int ret;
+    while ((ret = getopt(argc, argv, "l:p:c:r:d:n:m:h")) != -1) {
+        switch (ret) {
+        case 'l': host = optarg; break;
+        case 'p': port = std::stoul(optarg); break;
+        case 'c': concurrency = std::stoul(optarg); break;
+        case 'r': rate = std::stoul(optarg); break;
+        case 'd': duration = std::chrono::seconds(std::stoul(optarg)); break;
+        case 'n': hosts = std::stoul(optarg); break;
+        case 'm':
+            if (std::sscanf(optarg, "%zu:%zu:%zu", &mix[load_post], &mix[load_get], &mix[load_put]) != 3)
+                usage(argv);
+            break;
+        case 'h':
+        default:
+            usage(argv);
+            break;
+        }
+    }
+    if (optind != argc || !concurrency || !hosts)
+        usage(argv);
+    auto ep = make_endpoint(host, port);
+    started_at = std::chrono::system_clock::now();
+    stopped_at = started_at + duration;
+    for (std::size_t i = 0; i < concurrency; ++i)
+        run(std::make_shared<load_worker>(ioc, ep));
+    ioc.run();
+    auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::system_clock::now() - started_at).count();
+    std::vector<std::chrono::microseconds> total;
+    std::uint64_t errors = 0;
+    for (std::size_t op = 0; op < load_ops; ++op) {
+        report(load_op_names[op], stats[op].latencies, stats[op].errors, elapsed);
+        total.insert(total.end(), stats[op].latencies.begin(), stats[op].latencies.end());
+        errors += stats[op].errors;
+    }
+    report("total", std::move(total), errors, elapsed);
+    return 0;
+}
@@ -0,0 +1,475 @@
+#include "http.hpp"
+#include "uri.hpp"
+
+#include <boost/beast/websocket.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <getopt.h>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <unordered_map>
+
+static const int janus_error_unknown = 490;
+static const int janus_error_session_not_found = 458;
+static const int janus_error_handle_not_found = 459;
+static const int janus_error_unknown_request = 453;
+static const int streaming_error_no_such_mountpoint = 455;
+static const int streaming_error_cant_create = 456;
+static const int streaming_error_unauthorized = 457;
+
+static std::string host = "127.0.0.1";
+static std::uint16_t port = 8088;
+static std::uint16_t admin_port = 8089;
+static std::uint16_t ws_port = 8188;
+static std::chrono::milliseconds latency(0);
+static double failures = 0;
+static std::uint64_t exit_after = 0;
+static std::string admin_key;
+
+struct mock_session
+{
+    std::uint64_t id;
+    const void* owner;
+};
+
+static std::unordered_map<std::uint64_t, mock_session> sessions;
+static std::unordered_map<std::uint64_t, std::uint64_t> handles;
+static std::map<std::uint64_t, nlohmann::json> mountpoints;
+static std::mt19937_64 random_engine(std::random_device{}());
+static std::uint64_t requests = 0;
+
+static boost::asio::io_context ioc;
+
+static std::uint64_t make_id()
+{ return random_engine() & ((std::uint64_t(1) << 53) - 1); }
+
+static nlohmann::json make_error(const nlohmann::json& req_json, int code, const std::string& reason)
+{
+    nlohmann::json res_json;
+    res_json["janus"] = "error";
+    res_json["transaction"] = req_json.value("transaction", "");
+    res_json["error"]["code"] = code;
+    res_json["error"]["reason"] = reason;
+    return res_json;
+}
+
+static nlohmann::json make_success(const nlohmann::json& req_json)
+{
+    nlohmann::json res_json;
+    res_json["janus"] = "success";
+    res_json["transaction"] = req_json.value("transaction", "");
+    return res_json;
+}
+
+static nlohmann::json make_plugin_error(const nlohmann::json& res_json, int code, const std::string& reason)
+{
+    auto r = res_json;
+    r["plugindata"]["data"]["streaming"] = "event";
+    r["plugindata"]["data"]["error_code"] = code;
+    r["plugindata"]["data"]["error"] = reason;
+    return r;
+}
+
+static nlohmann::json handle_message(const nlohmann::json& req_json, std::uint64_t session_plugin_id)
+{
+    auto res_json = make_success(req_json);
+    res_json["sender"] = session_plugin_id;
+    res_json["plugindata"]["plugin"] = "janus.plugin.streaming";
+    auto& data = res_json["plugindata"]["data"];
+    const auto& body = req_json.at("body");
+    std::string request = body.at("request");
+    // As in the streaming plugin: with an admin_key configured, create needs it
+    // and list shows private mountpoints only to a request that carries it.
+    bool admin = false;
+    if (!admin_key.empty() && (request == "create" || !body.value("admin_key", "").empty())) {
+        if (body.value("admin_key", "") != admin_key)
+            return make_plugin_error(res_json, streaming_error_unauthorized, "unauthorized request");
+        admin = true;
+    }
+    if (request == "create") {
+        std::uint64_t id = body.value("id", make_id());
+        if (mountpoints.count(id))
+            return make_plugin_error(res_json, streaming_error_cant_create, "mountpoint already exists");
+        mountpoints[id] = body;
+        data["streaming"] = "created";
+        data["created"] = body.value("name", std::to_string(id));
+        data["stream"]["id"] = id;
+        data["stream"]["type"] = "live";
+    } else if (request == "destroy") {
+        std::uint64_t id = body.at("id");
+        if (!mountpoints.erase(id))
+            return make_plugin_error(res_json, streaming_error_no_such_mountpoint, "no such mountpoint");
+        data["streaming"] = "destroyed";
+        data["destroyed"] = id;
+    } else if (request == "list") {
+        data["streaming"] = "list";
+        data["list"] = nlohmann::json::array();
+        for (const auto& m : mountpoints) {
+            if (m.second.value("is_private", false) && !admin)
+                continue;
+            nlohmann::json item;
+            item["id"] = m.first;
+            item["type"] = "live";
+            item["description"] = m.second.value("description", std::to_string(m.first));
+            item["videoport"] = m.second.value("videoport", 0);
+            item["audioport"] = m.second.value("audioport", 0);
+            data["list"].push_back(item);
+        }
+    } else {
+        return make_plugin_error(res_json, janus_error_unknown_request, "unknown request " + request);
+    }
+    return res_json;
+}
+
+static nlohmann::json handle_request(const nlohmann::json& req_json,
+    std::uint64_t session_id, std::uint64_t session_plugin_id, const void* owner)
+{
+    if (exit_after && ++requests > exit_after) {
+        BOOST_LOG_TRIVIAL(info) << "exit after " << exit_after << " requests";
+        std::_Exit(1);
+    }
+    if (failures > 0 && std::uniform_real_distribution<double>(0, 1)(random_engine) < failures)
+        return make_error(req_json, janus_error_unknown, "injected failure");
+    std::string janus = req_json.value("janus", "");
+    if (janus == "ping") {
+        auto res_json = make_success(req_json);
+        res_json["janus"] = "pong";
+        return res_json;
+    }
+    if (janus == "info") {
+        auto res_json = make_success(req_json);
+        res_json["janus"] = "server_info";
+        res_json["name"] = "janus-mock";
+        return res_json;
+    }
+    if (janus == "create" && !session_id) {
+        auto res_json = make_success(req_json);
+        auto id = make_id();
+        sessions[id] = {id, owner};
+        res_json["data"]["id"] = id;
+        return res_json;
+    }
+    if (!sessions.count(session_id))
+        return make_error(req_json, janus_error_session_not_found, "no such session");
+    if (janus == "keepalive") {
+        auto res_json = make_success(req_json);
+        res_json["janus"] = "ack";
+        return res_json;
+    }
+    if (janus == "destroy" && !session_plugin_id) {
+        sessions.erase(session_id);
+        return make_success(req_json);
+    }
+    if (janus == "attach" && !session_plugin_id) {
+        if (req_json.value("plugin", "") != "janus.plugin.streaming")
+            return make_error(req_json, janus_error_unknown, "no such plugin");
+        auto res_json = make_success(req_json);
+        auto id = make_id();
+        handles[id] = session_id;
+        res_json["data"]["id"] = id;
+        return res_json;
+    }
+    auto it = handles.find(session_plugin_id);
+    if (it == handles.end() || it->second != session_id)
+        return make_error(req_json, janus_error_handle_not_found, "no such handle");
+    if (janus == "message" && req_json.count("body"))
+        return handle_message(req_json, session_plugin_id);
+    return make_error(req_json, janus_error_unknown_request, "unknown request " + janus);
+}
+
+static nlohmann::json handle_safe(const std::string& body,
+    std::uint64_t session_id, std::uint64_t session_plugin_id, const void* owner)
+{
+    nlohmann::json req_json;
+    try {
+        req_json = nlohmann::json::parse(body);
+        return handle_request(req_json, session_id, session_plugin_id, owner);
+    } catch (const std::exception& e) {
+        return make_error(req_json.is_object() ? req_json : nlohmann::json::object(),
+            janus_error_unknown, e.what());
+    }
+}
+
+static void delay(std::function<void()> handler)
+{
+    if (latency.count() == 0) {
+        boost::asio::post(ioc, handler);
+        return;
+    }
+    auto timer = std::make_shared<boost::asio::system_timer>(ioc);
+    timer->expires_from_now(latency);
+    timer->async_wait([timer, handler](boost::system::error_code) { handler(); });
+}
+
+static bool parse_target(boost::string_view path, std::uint64_t& session_id, std::uint64_t& session_plugin_id)
+{
+    static const boost::string_view prefix = "/janus";
+    if (path.substr(0, prefix.size()) != prefix)
+        return false;
+    path.remove_prefix(prefix.size());
+    std::uint64_t* ids[] = {&session_id, &session_plugin_id};
+    for (auto id : ids) {
+        if (path.empty() || path == "/")
+            return true;
+        path.remove_prefix(1);
+        auto pos = std::min(path.find('/'), path.size());
+        if (!uri_to_uint(path.substr(0, pos), *id))
+            return false;
+        path.remove_prefix(pos);
+    }
+    return path.empty() || path == "/";
+}
+
+static void handle_http(http_req& req, http_res& res, http_callback callback)
+{
+    std::uint64_t session_id = 0;
+    std::uint64_t session_plugin_id = 0;
+    if (req.method() != boost::beast::http::verb::post ||
+        !parse_target(make_uri(boost::string_view(req.target().data(), req.target().size())).path,
+            session_id, session_plugin_id)) {
+        res.result(boost::beast::http::status::not_found);
+        callback();
+        return;
+    }
+    auto res_json = handle_safe(req.body(), session_id, session_plugin_id, nullptr);
+    delay([&res, callback, res_json]() {
+        res.result(boost::beast::http::status::ok);
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = res_json.dump();
+        callback();
+    });
+}
+
+static void handle_admin(http_req& req, http_res& res, http_callback callback)
+{
+    if (req.method() != boost::beast::http::verb::post ||
+        make_uri(boost::string_view(req.target().data(), req.target().size())).path != "/admin") {
+        res.result(boost::beast::http::status::not_found);
+        callback();
+        return;
+    }
+    nlohmann::json res_json;
+    try {
+        auto req_json = nlohmann::json::parse(req.body());
+        std::string janus = req_json.value("janus", "");
+        if (janus == "ping") {
+            res_json = make_success(req_json);
+            res_json["janus"] = "pong";
+        } else if (janus == "info") {
+            res_json = make_success(req_json);
+            res_json["janus"] = "server_info";
+            res_json["name"] = "janus-mock";
+            res_json["sessions"] = sessions.size();
+        } else {
+            res_json = make_error(req_json, janus_error_unknown_request, "unknown request " + janus);
+        }
+    } catch (const std::exception& e) {
+        res_json = make_error(nlohmann::json::object(), janus_error_unknown, e.what());
+    }
+    delay([&res, callback, res_json]() {
+        res.result(boost::beast::http::status::ok);
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = res_json.dump();
+        callback();
+    });
+}
+
+class ws_session : public std::enable_shared_from_this<ws_session>
+{
+public:
+    explicit ws_session(boost::asio::ip::tcp::socket socket)
+        : stream_(std::move(socket))
+    {
+    }
+
+    void operator()()
+    {
+        auto self = shared_from_this();
+        stream_.set_option(boost::beast::websocket::stream_base::decorator(
+            [](boost::beast::websocket::response_type& res) {
+                res.set(boost::beast::http::field::sec_websocket_protocol, "janus-protocol");
+            }));
+        stream_.text(true);
+        stream_.async_accept(
+            [self](boost::system::error_code e) {
+                if (!e)
+                    self->recv();
+            });
+    }
+private:
+    void recv()
+    {
+        auto self = shared_from_this();
+        stream_.async_read(buffer_,
+            [self](boost::system::error_code e, std::size_t) {
+                if (e) {
+                    self->close();
+                    return;
+                }
+                auto body = boost::beast::buffers_to_string(self->buffer_.data());
+                self->buffer_.consume(self->buffer_.size());
+                nlohmann::json req_json;
+                std::uint64_t session_id = 0;
+                std::uint64_t session_plugin_id = 0;
+                try {
+                    req_json = nlohmann::json::parse(body);
+                    session_id = req_json.value("session_id", std::uint64_t(0));
+                    session_plugin_id = req_json.value("handle_id", std::uint64_t(0));
+                } catch (const std::exception&) {
+                }
+                auto res_json = handle_safe(body, session_id, session_plugin_id, self.get());
+                delay([self, res_json]() { self->send(res_json.dump()); });
+                self->recv();
+            });
+    }
+
+    void send(std::string msg)
+    {
+        messages_.push_back(std::move(msg));
+        if (messages_.size() > 1)
+            return;
+        write();
+    }
+
+    void write()
+    {
+        auto self = shared_from_this();
+        stream_.async_write(boost::asio::buffer(messages_.front()),
+            [self](boost::system::error_code e, std::size_t) {
+                self->messages_.pop_front();
+                if (!e && !self->messages_.empty())
+                    self->write();
+            });
+    }
+
+    void close()
+    {
+        for (auto it = sessions.begin(); it != sessions.end(); )
+            it = it->second.owner == this ? sessions.erase(it) : std::next(it);
+    }
+
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> stream_;
+    boost::beast::flat_buffer buffer_;
+    std::deque<std::string> messages_;
+};
+
+static void accept_ws(boost::asio::ip::tcp::acceptor& acceptor)
+{
+    acceptor.async_accept(
+        [&acceptor](boost::system::error_code e, boost::asio::ip::tcp::socket socket) {
+            if (e == boost::asio::error::operation_aborted)
+                return;
+            if (!e)
+                std::make_shared<ws_session>(std::move(socket))->operator()();
+            accept_ws(acceptor);
+        });
+}
+
+static void read_port(const std::string& path, const std::string& key, std::uint16_t& value)
+{
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        auto pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, key.size(), key) != 0)
+            continue;
+        pos = line.find_first_not_of(" \t=", pos + key.size());
+        if (pos != std::string::npos && std::isdigit(static_cast<unsigned char>(line[pos]))) {
+            value = std::stoul(line.substr(pos));
+            return;
+        }
+    }
+}
+
+static void read_string(const std::string& path, const std::string& key, std::string& value)
+{
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        auto pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, key.size(), key) != 0)
+            continue;
+        auto begin = line.find('"', pos + key.size());
+        auto end = begin == std::string::npos ? begin : line.find('"', begin + 1);
+        if (end != std::string::npos) {
+            value = line.substr(begin + 1, end - begin - 1);
+            return;
+        }
+    }
+}
+
+static void read_configs(const std::string& folder)
+{
+    read_port(folder + "/janus.transport.http.jcfg", "port", port);
+    read_port(folder + "/janus.transport.http.jcfg", "admin_port", admin_port);
+    read_port(folder + "/janus.transport.websockets.jcfg", "ws_port", ws_port);
+    read_string(folder + "/janus.plugin.streaming.jcfg", "admin_key", admin_key);
+}
+
+static void usage(char* argv[])
+{
+    std::printf("Usage: %s [OPTIONS]", argv[0]);
+    std::printf("\n  -h help");
+    std::printf("\n  -l arg (%s) host", host.c_str());
+    std::printf("\n  -q arg (%u) http port", port);
+    std::printf("\n  -a arg (%u) admin port", admin_port);
+    std::printf("\n  -o arg (%u) ws port", ws_port);
+    std::printf("\n  -t arg (%lld) latency, ms", static_cast<long long>(latency.count()));
+    std::printf("\n  -f arg (%g) failure rate, 0..1", failures);
+    std::printf("\n  -x arg (%llu) exit after requests, 0 to never exit", static_cast<unsigned long long>(exit_after));
+    std::printf("\n  -k arg (%s) streaming admin key, private mountpoints are listed only with it", admin_key.c_str());
+    std::printf("\n  --configs-folder arg read port, admin_port, ws_port and admin_key from the janus configs, if any");
+    std::printf("\n");
+    std::printf("\nJANUS_MOCK_LATENCY, JANUS_MOCK_FAILURES and JANUS_MOCK_EXIT set the defaults");
+    std::printf("\nof -t, -f and -x when the mock is spawned by janus-manager.");
+    std::printf("\n");
+    std::printf("\n");
+    std::exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+    if (auto env = std::getenv("JANUS_MOCK_LATENCY"))
+        latency = std::chrono::milliseconds(std::stoul(env));
+    if (auto env = std::getenv("JANUS_MOCK_FAILURES"))
+        failures = std::stod(env);
+    if (auto env = std::getenv("JANUS_MOCK_EXIT"))
+        exit_after = std::stoull(env);
+    static const option options[] = {
+        {"configs-folder", required_argument, nullptr, 'C'},
+        {nullptr, 0, nullptr, 0}};
+    int ret;
+    while ((ret = getopt_long(argc, argv, "l:q:a:o:t:f:x:k:h", options, nullptr)) != -1) {
+        switch (ret) {
+        case 'C': read_configs(optarg); break;
+        case 'l': host = optarg; break;
+        case 'q': port = std::stoul(optarg); break;
+        case 'a': admin_port = std::stoul(optarg); break;
+        case 'o': ws_port = std::stoul(optarg); break;
+        case 't': latency = std::chrono::milliseconds(std::stoul(optarg)); break;
+        case 'f': failures = std::stod(optarg); break;
+        case 'x': exit_after = std::stoull(optarg); break;
+        case 'k': admin_key = optarg; break;
+        case 'h':
+        default:
+            usage(argv);
+            break;
+        }
+    }
+    if (optind != argc)
+        usage(argv);
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::info);
+    http_server s(ioc, make_endpoint(host, port), handle_http);
+    http_server admin(ioc, make_endpoint(host, admin_port), handle_admin);
+    boost::asio::ip::tcp::acceptor acceptor(ioc, make_endpoint(host, ws_port));
+    accept_ws(acceptor);
+    BOOST_LOG_TRIVIAL(info) << "janus-mock http " << host << ":" << port << " admin " << host << ":" << admin_port
+        << " ws " << host << ":" << ws_port;
+    ioc.run();
+    return 0;
+}